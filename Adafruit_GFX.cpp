@@ -38,6 +38,7 @@ by James Kidd 2014
 
 #include <stdint.h>
 #include "Adafruit_GFX.h"
+#include "SSD1306_Perf.h"
 #include "glcdfont.c"
 #include <math.h>
 #include <stdlib.h>
@@ -61,6 +62,7 @@ Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h):
 // Draw a circle outline
 void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r,
     uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_CIRCLE);
   int16_t f = 1 - r;
   int16_t ddF_x = 1;
   int16_t ddF_y = -2 * r;
@@ -131,6 +133,7 @@ void Adafruit_GFX::drawCircleHelper( int16_t x0, int16_t y0,
 
 void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r,
                   uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLCIRCLE);
   drawFastVLine(x0, y0-r, 2*r+1, color);
   fillCircleHelper(x0, y0, r, 3, 0, color);
 }
@@ -170,6 +173,7 @@ void Adafruit_GFX::fillCircleHelper(int16_t x0, int16_t y0, int16_t r,
 void Adafruit_GFX::drawLine(int16_t x0, int16_t y0,
                 int16_t x1, int16_t y1,
                 uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_LINE);
   int16_t steep =  abs(y1 - y0) > abs(x1 - x0);
   if (steep) {
     GFXswap(x0, y0);
@@ -212,6 +216,7 @@ void Adafruit_GFX::drawLine(int16_t x0, int16_t y0,
 void Adafruit_GFX::drawRect(int16_t x, int16_t y,
                 int16_t w, int16_t h,
                 uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_RECT);
   drawFastHLine(x, y, w, color);
   drawFastHLine(x, y+h-1, w, color);
   drawFastVLine(x, y, h, color);
@@ -232,6 +237,7 @@ void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y,
 
 void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
                 uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLRECT);
   // Update in subclasses if desired!
   for (int16_t i=x; i<x+w; i++) {
     drawFastVLine(i, y, h, color);
@@ -239,12 +245,14 @@ void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
 }
 
 void Adafruit_GFX::fillScreen(uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLSCREEN);
   fillRect(0, 0, _width, _height, color);
 }
 
 // Draw a rounded rectangle
 void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w,
   int16_t h, int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_ROUNDRECT);
   // smarter version
   drawFastHLine(x+r  , y    , w-2*r, color); // Top
   drawFastHLine(x+r  , y+h-1, w-2*r, color); // Bottom
@@ -260,6 +268,7 @@ void Adafruit_GFX::drawRoundRect(int16_t x, int16_t y, int16_t w,
 // Fill a rounded rectangle
 void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w,
                  int16_t h, int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLROUNDRECT);
   // smarter version
   fillRect(x+r, y, w-2*r, h, color);
 
@@ -272,6 +281,7 @@ void Adafruit_GFX::fillRoundRect(int16_t x, int16_t y, int16_t w,
 void Adafruit_GFX::drawTriangle(int16_t x0, int16_t y0,
                 int16_t x1, int16_t y1,
                 int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_TRIANGLE);
   drawLine(x0, y0, x1, y1, color);
   drawLine(x1, y1, x2, y2, color);
   drawLine(x2, y2, x0, y0, color);
@@ -281,6 +291,7 @@ void Adafruit_GFX::drawTriangle(int16_t x0, int16_t y0,
 void Adafruit_GFX::fillTriangle ( int16_t x0, int16_t y0,
                   int16_t x1, int16_t y1,
                   int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLTRIANGLE);
 
   int16_t a, b, y, last;
 
@@ -359,6 +370,7 @@ void Adafruit_GFX::fillTriangle ( int16_t x0, int16_t y0,
 void Adafruit_GFX::drawBitmap(int16_t x, int16_t y,
                   const uint8_t *bitmap, int16_t w, int16_t h,
                   uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_BITMAP);
 
   int16_t i, j, byteWidth = (w + 7) / 8;
 
@@ -377,6 +389,7 @@ void Adafruit_GFX::drawBitmap(int16_t x, int16_t y,
 void Adafruit_GFX::drawBitmap(int16_t x, int16_t y,
             const uint8_t *bitmap, int16_t w, int16_t h,
             uint16_t color, uint16_t bg) {
+  SSD1306_PERF_CALL(SSD1306_PERF_BITMAP);
 
   int16_t i, j, byteWidth = (w + 7) / 8;
   
@@ -398,6 +411,7 @@ void Adafruit_GFX::drawBitmap(int16_t x, int16_t y,
 void Adafruit_GFX::drawXBitmap(int16_t x, int16_t y,
                               const uint8_t *bitmap, int16_t w, int16_t h,
                               uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_BITMAP);
   
   int16_t i, j, byteWidth = (w + 7) / 8;
   
@@ -431,9 +445,14 @@ uint8_t Adafruit_GFX::write(uint8_t c) {
 
 }
 
+const unsigned char *Adafruit_GFX::glyph(unsigned char c) {
+  return font + c * 5;
+}
+
 // Draw a character
 void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c,
                 uint16_t color, uint16_t bg, uint8_t size) {
+  SSD1306_PERF_CALL(SSD1306_PERF_CHAR);
 
   if((x >= _width)            || // Clip right
      (y >= _height)           || // Clip bottom
@@ -494,6 +513,30 @@ uint8_t Adafruit_GFX::getRotation(void) const {
   return rotation;
 }
 
+int16_t Adafruit_GFX::getCursorX(void) const {
+  return cursor_x;
+}
+
+int16_t Adafruit_GFX::getCursorY(void) const {
+  return cursor_y;
+}
+
+uint16_t Adafruit_GFX::getTextColor(void) const {
+  return textcolor;
+}
+
+uint16_t Adafruit_GFX::getTextBackground(void) const {
+  return textbgcolor;
+}
+
+uint8_t Adafruit_GFX::getTextSize(void) const {
+  return textsize;
+}
+
+bool Adafruit_GFX::getTextWrap(void) const {
+  return wrap;
+}
+
 void Adafruit_GFX::setRotation(uint8_t x) {
   rotation = (x & 3);
   switch(rotation) {
@@ -660,6 +703,87 @@ uint8_t Adafruit_GFX::println(double num, int digits)
 
 // Private Methods /////////////////////////////////////////////////////////////
 
+// n / 10 with shifts and adds, as the M0 has no divide instruction;
+// the remainder goes in *r
+static inline uint32_t divu10(uint32_t n, uint8_t *r) {
+  uint32_t q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q += q >> 16;
+  q >>= 3;
+  uint32_t rem = n - ((q << 3) + (q << 1));
+  if (rem > 9) {
+    q++;
+    rem -= 10;
+  }
+  *r = rem;
+  return q;
+}
+
+static const uint32_t powersOf10[10] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Longest formatted field: sign, 10 digits, point, 9 decimals and padding
+#define FIXED_BUF 32
+
+// Format n / 10^digits right aligned into buf[FIXED_BUF], returning the
+// start of the text; zero padding goes between the sign and the digits
+static char *formatFixed(char *buf, uint32_t n, bool negative, uint8_t digits,
+                         uint8_t width, char pad) {
+  char *end = buf + FIXED_BUF;
+  char *p = end;
+  uint8_t r;
+
+  for (uint8_t i = 0; i < digits; i++) {
+    n = divu10(n, &r);
+    *--p = '0' + r;
+  }
+  if (digits > 0) *--p = '.';
+  do {
+    n = divu10(n, &r);
+    *--p = '0' + r;
+  } while (n);
+
+  if (width > FIXED_BUF) width = FIXED_BUF;
+  if (pad == '0') {
+    while (end - p < width - negative) *--p = '0';
+    if (negative) *--p = '-';
+  } else {
+    if (negative) *--p = '-';
+    while (end - p < width) *--p = pad;
+  }
+  return p;
+}
+
+uint8_t Adafruit_GFX::printFixed(int32_t value, uint8_t scale, uint8_t digits,
+                                 uint8_t width, char pad) {
+  if (digits > 9) digits = 9;
+  bool negative = value < 0;
+  uint32_t n = negative ? -(uint32_t) value : value;
+  uint8_t r;
+
+  // drop the decimals beyond digits, rounding half up, or scale up for
+  // the ones the value doesn't have when that fits
+  if (scale > digits) {
+    for (uint8_t i = digits + 1; i < scale; i++) n = divu10(n, &r);
+    n = divu10(n, &r);
+    if (r >= 5) n++;
+  } else {
+    while (scale < digits && n <= 429496729) {
+      n = (n << 3) + (n << 1);
+      scale++;
+    }
+    digits = scale;
+  }
+  // no "-0" when the value rounds to zero
+  if (n == 0) negative = false;
+
+  char buf[FIXED_BUF];
+  char *p = formatFixed(buf, n, negative, digits, width, pad);
+  return write(p, buf + FIXED_BUF - p);
+}
+
 uint8_t Adafruit_GFX::printNumber(unsigned long n, uint8_t base) {
   char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
   char *str = &buf[sizeof(buf) - 1];
@@ -669,12 +793,20 @@ uint8_t Adafruit_GFX::printNumber(unsigned long n, uint8_t base) {
   // prevent crash if called with base == 1
   if (base < 2) base = 10;
 
-  do {
+  // decimal digits that fit 32 bits need no divide
+  while (base != 10 || n > 0xFFFFFFFFUL) {
     unsigned long m = n;
     n /= base;
     char c = m - base * n;
     *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+    if (n == 0) return write(str);
+  }
+
+  do {
+    uint8_t r;
+    n = divu10(n, &r);
+    *--str = '0' + r;
+  } while (n);
 
   return write(str);
 }
@@ -705,6 +837,28 @@ uint8_t Adafruit_GFX::printFloat(double number, uint8_t digits)
   // Extract the integer part of the number and print it
   unsigned long int_part = (unsigned long)number;
   double remainder = number - (double)int_part;
+
+  // Up to 9 decimals are formatted into one buffer and written at once,
+  // taking the digits from the remainder with the same steps as below
+  if (digits <= 9) {
+    char buf[FIXED_BUF];
+    char *p = buf + FIXED_BUF - digits;
+    for (uint8_t i = 0; i < digits; i++) {
+      remainder *= 10.0;
+      int toPrint = int(remainder);
+      p[i] = '0' + toPrint;
+      remainder -= toPrint;
+    }
+    if (digits > 0) *--p = '.';
+    uint32_t m = int_part;
+    uint8_t r;
+    do {
+      m = divu10(m, &r);
+      *--p = '0' + r;
+    } while (m);
+    return n + write(p, buf + FIXED_BUF - p);
+  }
+
   n += print(int_part);
 
   // Print the decimal point, but only if there are digits beyond
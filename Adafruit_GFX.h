@@ -66,16 +66,11 @@ class Adafruit_GFX  {
     drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color),
     fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color),
     fillScreen(uint16_t color),
-    invertDisplay(bool i);
-
-  // These exist only with Adafruit_GFX (no subclass overrides)
-  void
+    invertDisplay(bool i),
+    drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+      uint16_t bg, uint8_t size),
     drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color),
-    drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername,
-      uint16_t color),
     fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color),
-    fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername,
-      int16_t delta, uint16_t color),
     drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
       int16_t x2, int16_t y2, uint16_t color),
     fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
@@ -88,16 +83,21 @@ class Adafruit_GFX  {
       int16_t w, int16_t h, uint16_t color),
     drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
       int16_t w, int16_t h, uint16_t color, uint16_t bg),
+    setRotation(uint8_t r);
+
+  // These exist only with Adafruit_GFX (no subclass overrides)
+  void
+    drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername,
+      uint16_t color),
+    fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t cornername,
+      int16_t delta, uint16_t color),
     drawXBitmap(int16_t x, int16_t y, const uint8_t *bitmap, 
       int16_t w, int16_t h, uint16_t color),
-    drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
-      uint16_t bg, uint8_t size),
     setCursor(int16_t x, int16_t y),
     setTextColor(uint16_t c),
     setTextColor(uint16_t c, uint16_t bg),
     setTextSize(uint8_t s),
-    setTextWrap(bool w),
-    setRotation(uint8_t r);
+    setTextWrap(bool w);
 
 
   int16_t height(void) const;
@@ -105,7 +105,19 @@ class Adafruit_GFX  {
 
   uint8_t getRotation(void) const;
 
+  // The text settings, for saving and restoring around drawing text
+  int16_t getCursorX(void) const;
+  int16_t getCursorY(void) const;
+  uint16_t getTextColor(void) const;
+  uint16_t getTextBackground(void) const;
+  uint8_t getTextSize(void) const;
+  bool getTextWrap(void) const;
+
  protected:
+  // The 5 column bytes of character c in the built in font, bit 0 at the
+  // top, as the SSD1306 stores a page column
+  static const unsigned char *glyph(unsigned char c);
+
   const int16_t
     WIDTH, HEIGHT;   // This is the 'raw' display w/h - never changes
   int16_t
@@ -125,7 +137,7 @@ class Adafruit_GFX  {
   uint8_t printNumber(unsigned long, uint8_t);
   uint8_t printFloat(double, uint8_t);
 public:
-  uint8_t write(uint8_t);
+  virtual uint8_t write(uint8_t);
   uint8_t write(const char *str) {
         if (str == NULL) return 0;
         return write((const uint8_t *)str, strlen(str));
@@ -144,6 +156,12 @@ public:
      uint8_t print(unsigned long, int = DEC);
      uint8_t print(double, int = 2);
 
+     // value / 10^scale with digits decimals (at most 9), rounded and right
+     // aligned in a field of width characters filled with pad.  Formatted
+     // with integer math only, then written in one go.
+     uint8_t printFixed(int32_t value, uint8_t scale, uint8_t digits,
+                        uint8_t width = 0, char pad = ' ');
+
      uint8_t println(const char[]);
      uint8_t println(char);
      uint8_t println(unsigned char, int = DEC);
@@ -17,9 +17,14 @@ All text above, and the splash screen below must be included in any redistributi
 *********************************************************************/
 
 #include "Adafruit_SSD1306.h"
+#include "SSD1306_Render.h"
 //#include <stdlib.h>
 
-static char buffer[SSD1306_LCDHEIGHT * SSD1306_LCDWIDTH / 8] = {
+#define SSD1306_TEMPLATE template <int16_t W, int16_t H, uint8_t COMPINS, uint8_t COLOFFSET>
+#define SSD1306_PANEL Adafruit_SSD1306_Panel<W, H, COMPINS, COLOFFSET>
+
+// Splash screen, loaded into the buffer of 128x64 panels
+static const uint8_t splash[SSD1306_LCDHEIGHT * SSD1306_LCDWIDTH / 8] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -88,202 +93,1182 @@ static char buffer[SSD1306_LCDHEIGHT * SSD1306_LCDWIDTH / 8] = {
 
 #define ssd1306_swap(a, b) { int16_t t = a; a = b; b = t; }
 
-Adafruit_SSD1306::Adafruit_SSD1306(MicroBit & micro) : micro(micro), 
-Adafruit_GFX(128, 64) { 
+SSD1306_TEMPLATE
+inline void SSD1306_PANEL::markDirty(uint8_t page, uint8_t x0, uint8_t x1) {
+  if (x0 < dirty.min[page]) dirty.min[page] = x0;
+  if (x1 > dirty.max[page]) dirty.max[page] = x1;
+}
+
+SSD1306_TEMPLATE
+inline void SSD1306_PANEL::markDirtyPages(uint8_t first, uint8_t last, uint8_t x0, uint8_t x1) {
+  for (uint8_t page = first; page <= last; page++) {
+    markDirty(page, x0, x1);
+  }
+}
+
+SSD1306_TEMPLATE
+inline void SSD1306_PANEL::markClean(DirtyMap &d, uint8_t page) {
+  d.min[page] = W;
+  d.max[page] = 0;
+}
+
+SSD1306_TEMPLATE
+inline bool SSD1306_PANEL::isDirty(const DirtyMap &d, uint8_t page) {
+  return d.min[page] <= d.max[page];
+}
+
+// Pages the controller is scrolling can't be written until the scroll stops
+SSD1306_TEMPLATE
+inline bool SSD1306_PANEL::isScrolling(uint8_t page) {
+  return scrollDir && page >= scrollFirst && page <= scrollLast;
+}
+
+// Host builds have no fibers; there displayAsync() simply flushes in place.
+#ifdef SSD1306_HOST
+#define ssd1306_yield()
+#else
+#define ssd1306_yield() schedule()
+#endif
+
+typedef uint32_t __attribute__((may_alias)) ssd1306_word;
+
+// First column in x0..x1 where rows a and b differ, or x1 + 1 if none.
+// Both rows are word aligned, so the bulk of the scan compares 4 bytes at
+// a time.
+static uint8_t firstDiff(const char *a, const char *b, uint8_t x0, uint8_t x1)
+{
+  uint8_t x = x0;
+  while (x <= x1 && (x & 3)) {
+    if (a[x] != b[x]) return x;
+    x++;
+  }
+  while (x + 3 <= x1 && *(const ssd1306_word *)(a + x) == *(const ssd1306_word *)(b + x)) {
+    x += 4;
+  }
+  while (x <= x1 && a[x] == b[x]) x++;
+  return x;
+}
+
+// Last column in x0..x1 where rows a and b differ, or x0 - 1 if none
+static int16_t lastDiff(const char *a, const char *b, uint8_t x0, uint8_t x1)
+{
+  int16_t x = x1;
+  while (x >= x0 && ((x + 1) & 3)) {
+    if (a[x] != b[x]) return x;
+    x--;
+  }
+  while (x - 3 >= x0 && *(const ssd1306_word *)(a + x - 3) == *(const ssd1306_word *)(b + x - 3)) {
+    x -= 4;
+  }
+  while (x >= x0 && a[x] == b[x]) x--;
+  return x;
+}
+
+// The command sequence init() sends after reset, for a panel with the
+// given number of rows and COM pin configuration.  Fills out, which must
+// hold SSD1306_INIT_LEN bytes, and returns the number of bytes used.
+uint8_t ssd1306_initSequence(char *out, uint8_t rows, uint8_t compins)
+{
+    const char seq[SSD1306_INIT_LEN] = {
+        SSD1306_DISPLAYOFF,                     // 0xAE
+        SSD1306_SETDISPLAYCLOCKDIV,             // 0xD5
+        (char) 0x80,                            // the suggested ratio 0x80
+
+        SSD1306_SETMULTIPLEX,                   // 0xA8
+        (char) (rows - 1),
+
+        SSD1306_SETDISPLAYOFFSET,               // 0xD3
+        0x0,                                    // no offset
+        SSD1306_SETSTARTLINE | 0x0,             // line #0
+        SSD1306_CHARGEPUMP,                     // 0x8D
+        0x14,
+
+        SSD1306_MEMORYMODE,                     // 0x20
+        0x00,                                   // 0x0 act like ks0108
+        SSD1306_SEGREMAP | 0x1,
+        SSD1306_COMSCANDEC,
+
+        SSD1306_SETCOMPINS,                     // 0xDA
+        (char) compins,
+        SSD1306_SETCONTRAST,                    // 0x81
+        (char) 0xCF,
+
+        SSD1306_SETPRECHARGE,                   // 0xd9
+        (char) 0xF1,
+        SSD1306_SETVCOMDETECT,                  // 0xDB
+        0x40,
+        SSD1306_DISPLAYALLON_RESUME,            // 0xA4
+        SSD1306_NORMALDISPLAY,                  // 0xA6
+
+        SSD1306_DEACTIVATE_SCROLL,
+
+        SSD1306_DISPLAYON                       //--turn on oled panel
+    };
+    memcpy(out, seq, SSD1306_INIT_LEN);
+    return SSD1306_INIT_LEN;
+}
+
+SSD1306_TEMPLATE
+SSD1306_PANEL::Adafruit_SSD1306_Panel(SSD1306_Transport & transport, uint8_t *storage) :
+Adafruit_GFX(W, H), transport(transport), cmdLen(0), batchDepth(0), maxChunk(BUFSIZE) {
+  setup(storage);
  }
 
+#ifndef SSD1306_HOST
+// The micro:bit breakout: I2C at address (SSD1306_I2C_ADDRESS, or
+// SSD1306_I2C_ADDRESS_ALT with SA0 low), reset on P0.  The transport lives
+// as long as the program, like the display itself.
+SSD1306_TEMPLATE
+SSD1306_PANEL::Adafruit_SSD1306_Panel(MicroBit & micro, uint8_t address, uint8_t *storage) :
+Adafruit_GFX(W, H), transport(*new SSD1306_I2C(micro.i2c, micro.io.P0, address)), cmdLen(0), batchDepth(0), maxChunk(BUFSIZE) { 
+  setup(storage);
+ }
+#endif
 
+SSD1306_TEMPLATE
+void SSD1306_PANEL::setup(uint8_t *storage)
+{
+    if (storage == NULL) {
+        storage = (uint8_t *) malloc(FRAMESIZE);
+    }
+    // Out of memory leaves the panel without a buffer; init() reports it
+    buffer = (storage != NULL) ? (char *) storage + 4 : NULL;
+    spare = NULL;
+    sending = NULL;
+    flushing = false;
+#ifndef SSD1306_HOST
+    flushFiberStarted = false;
+#endif
+    shadow = NULL;
+    startLine = sendStartLine = panelStartLine = 0;
+    scrollDir = 0;
+    framePeriod = SSD1306_FRAME_US(H);
+    console = false;
+    consoleTop = 0;
+    consoleNewline = false;
+    rotated = &spans[rotation];
+    for (uint8_t page = 0; page < PAGES; page++) {
+        markClean(dirty, page);
+        markClean(sendDirty, page);
+    }
+    if (buffer == NULL) return;
 
-void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+    if (W == SSD1306_LCDWIDTH && H == SSD1306_LCDHEIGHT) {
+        memcpy(buffer, splash, BUFSIZE);
+    } else {
+        memset(buffer, 0, BUFSIZE);
+    }
+    invalidate();
+}
+
+// Ticket lock: panels get the bus in the order they asked for it
+uint16_t SSD1306_Bus::nextTicket = 0;
+uint16_t SSD1306_Bus::serving = 0;
+
+void SSD1306_Bus::acquire(void)
+{
+    uint16_t ticket = nextTicket++;
+#ifndef SSD1306_HOST
+    while (ticket != serving) {
+        fiber_wait_for_event(SSD1306_ID, SSD1306_EVT_BUS);
+    }
+#else
+    (void) ticket;
+#endif
+}
+
+void SSD1306_Bus::release(void)
 {
+    serving++;
+#ifndef SSD1306_HOST
+    if (serving != nextTicket) {
+        MicroBitEvent(SSD1306_ID, SSD1306_EVT_BUS);
+    }
+#endif
+}
+
+// Let anyone queued behind us have a turn, and other fibers run
+void SSD1306_Bus::yield(void)
+{
+    release();
+    ssd1306_yield();
+    acquire();
+}
+
+// Number of flushes queued behind the current holder
+uint16_t SSD1306_Bus::waiting(void)
+{
+    uint16_t queued = nextTicket - serving;
+    return queued ? queued - 1 : 0;
+}
+
+
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::ssd1306_command(uint8_t c)
+{
+    if (batchDepth) {
+        appendCommand(c);
+        return;
+    }
+
+    SSD1306_PERF_TIME(commandUs);
+    SSD1306_PERF_ADD(transactions, 1);
+    SSD1306_PERF_ADD(commandBytes, 1);
     char b[2] ;
-    b[0] = 0x0;
     b[1] = (char) c;
-    micro.i2c.write(0x7A, b, 2, false);
+    transport.sendCommands(b + 1, 1);
+}
+
+// Command batches
+// Everything passed to ssd1306_command() between beginCommands() and
+// commitCommands() is sent behind a single control byte in one I2C write.
+// A batch that outgrows the buffer is flushed early and carries on; the
+// controller doesn't care where a command's argument bytes are split.
+// Batches nest; only the outermost commit writes.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::beginCommands(void)
+{
+    batchDepth++;
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::appendCommand(uint8_t c)
+{
+    if (cmdLen == SSD1306_CMD_BATCH_MAX) {
+        flushCommands();
+    }
+    cmdBuf[++cmdLen] = (char) c;
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::commitCommands(void)
+{
+    if (batchDepth == 0 || --batchDepth) return;
+    flushCommands();
 }
 
-void Adafruit_SSD1306::display()
+SSD1306_TEMPLATE
+void SSD1306_PANEL::flushCommands(void)
 {
+    if (cmdLen == 0) return;
+    SSD1306_PERF_TIME(commandUs);
+    SSD1306_PERF_ADD(transactions, 1);
+    SSD1306_PERF_ADD(commandBytes, cmdLen);
+    transport.sendCommands(cmdBuf + 1, cmdLen);
+    cmdLen = 0;
+}
+
+// Largest number of data bytes sent per I2C write, for buses that can't take
+// a whole frame in one transfer.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::setMaxChunk(uint16_t bytes)
+{
+    maxChunk = bytes ? bytes : 1;
+}
+
+// Send len bytes starting at data as GDDRAM data, straight out of the
+// buffer: the transport may borrow data[-1] for a control byte.
+// In the background flush, each write is capped at one page and followed by
+// a yield so other fibers get to run between writes.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::sendData(char *data, uint16_t len, bool yield)
+{
+    uint16_t chunk = maxChunk;
+    if (yield && chunk > W) chunk = W;
+
+    while (len) {
+        uint16_t n = (len < chunk) ? len : chunk;
+        SSD1306_PERF_ADD(transactions, 1);
+        SSD1306_PERF_ADD(dataBytes, n);
+        transport.sendData(data, n);
+        data += n;
+        len -= n;
+        if (yield) SSD1306_Bus::yield();
+    }
+}
+
+// Send columns x0..x1 of pages first..last of frame.  The controller is in
+// horizontal addressing mode, so it wraps from x1 back to x0 on the next
+// page by itself.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::displayWindow(char *frame, uint8_t x0, uint8_t x1,
+                                     uint8_t first, uint8_t last, bool yield)
+{
+    beginCommands();
     ssd1306_command(SSD1306_COLUMNADDR);
-    ssd1306_command(0);   // Column start address (0 = reset)
-    ssd1306_command(SSD1306_LCDWIDTH-1); // Column end address (127 = reset)
+    ssd1306_command(x0 + COLOFFSET);   // Column start address
+    ssd1306_command(x1 + COLOFFSET);   // Column end address
 
     ssd1306_command(SSD1306_PAGEADDR);
-    ssd1306_command(0); // Page start address (0 = reset)
-    ssd1306_command(7); // Page end address
+    ssd1306_command(first); // Page start address
+    ssd1306_command(last);  // Page end address
+    commitCommands();
+
+    if (x0 == 0 && x1 == W - 1) {
+        // full width rows are contiguous in the buffer
+        sendData(frame + first * W, (last - first + 1) * W, yield);
+    } else {
+        for (uint8_t page = first; page <= last; page++) {
+            sendData(frame + page * W + x0, x1 - x0 + 1, yield);
+        }
+    }
 
-    char b[17];
+    if (shadow) {
+        for (uint8_t page = first; page <= last; page++) {
+            uint16_t offset = page * W + x0;
+            memcpy(shadow + offset, frame + offset, x1 - x0 + 1);
+            if (x0 == 0 && x1 == W - 1) shadowValid |= (1 << page);
+        }
+    }
+}
 
-    for (uint16_t i=0; i<(SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8); i = i+16 ) {
-        b[0] = (char) 0x40;
-        for (uint8_t n=0; n<16; n++) {
-            b[n+1] = buffer[i+n];
+// Send only the bytes in columns x0..x1 of page that differ from the shadow.
+// Runs of changes closer together than the cost of a new address window
+// are sent as one.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::displayPageDiff(char *frame, uint8_t page, uint8_t x0, uint8_t x1, bool yield)
+{
+    const char *row = frame + page * W;
+    const char *old = shadow + page * W;
+
+    uint8_t start = firstDiff(row, old, x0, x1);
+    while (start <= x1) {
+        uint8_t end = start;
+        while (true) {
+            while (end < x1 && row[end + 1] != old[end + 1]) end++;
+            if (end == x1) break;
+            uint8_t next = firstDiff(row, old, end + 1, x1);
+            if (next > x1 || next - end - 1 > SSD1306_WINDOW_COST) break;
+            end = next;
         }
-        micro.i2c.write(0x7A, b, 17);
+        displayWindow(frame, start, end, page, page, yield);
+        if (end == x1) break;
+        start = firstDiff(row, old, end + 1, x1);
     }
 }
 
-void Adafruit_SSD1306::init()
+// Keep a copy of what the panel last received and have display() compare
+// against it, sending only the bytes that really changed.  This costs an
+// extra frame of RAM, allocated here; returns false if that fails.
+SSD1306_TEMPLATE
+bool SSD1306_PANEL::setDiffMode(bool enable)
 {
+    waitForFlush();
+
+    if (!enable) {
+        free(shadow);
+        shadow = NULL;
+        return true;
+    }
+
+    if (shadow == NULL) {
+        shadow = (char *) malloc(BUFSIZE);
+        if (shadow == NULL) return false;
+        shadowValid = 0;
+    }
+    return true;
+}
+
+// Push the dirty parts of frame to the panel and mark them clean, and move
+// the display start line to line.  Adjacent dirty pages are merged into a
+// single window when the extra bytes cost less than setting up another
+// address window.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::flush(char *frame, DirtyMap &d, uint8_t line, bool yield)
+{
+    SSD1306_PERF_TIME(flushUs);
+    SSD1306_PERF_ADD(flushes, 1);
+    uint8_t page = 0;
+
+    // narrow each page's dirty range down to the bytes that actually differ
+    // from what the panel holds
+    if (shadow) {
+        for (page = 0; page < PAGES; page++) {
+            if (!isDirty(d, page) || !(shadowValid & (1 << page))) continue;
+            const char *row = frame + page * W;
+            const char *old = shadow + page * W;
+            uint8_t x0 = firstDiff(row, old, d.min[page], d.max[page]);
+            if (x0 > d.max[page]) {
+                markClean(d, page);
+                continue;
+            }
+            d.max[page] = lastDiff(row, old, x0, d.max[page]);
+            d.min[page] = x0;
+        }
+        page = 0;
+    }
+
+    SSD1306_Bus::acquire();
+    if (line != panelStartLine) {
+        // scroll first: a console line then fills in at the bottom
+        // rather than flashing up at the top
+        ssd1306_command(SSD1306_SETSTARTLINE | line);
+        panelStartLine = line;
+    }
+    while (page < PAGES) {
+        if (!isDirty(d, page) || isScrolling(page)) {
+            page++;
+            continue;
+        }
+
+        uint8_t first = page;
+        uint8_t x0 = d.min[page];
+        uint8_t x1 = d.max[page];
+
+        while (page + 1 < PAGES && isDirty(d, page + 1) && !isScrolling(page + 1)) {
+            uint8_t nx0 = (d.min[page + 1] < x0) ? d.min[page + 1] : x0;
+            uint8_t nx1 = (d.max[page + 1] > x1) ? d.max[page + 1] : x1;
+            uint16_t pages = page - first + 1;
+            uint16_t separate = (x1 - x0 + 1) * pages
+                              + (d.max[page + 1] - d.min[page + 1] + 1)
+                              + SSD1306_WINDOW_COST;
+            uint16_t merged = (nx1 - nx0 + 1) * (pages + 1);
+            if (merged > separate) break;
+            x0 = nx0;
+            x1 = nx1;
+            page++;
+        }
+
+        if (first == page && shadow && (shadowValid & (1 << page))) {
+            displayPageDiff(frame, page, x0, x1, yield);
+        } else {
+            displayWindow(frame, x0, x1, first, page, yield);
+        }
+        for (uint8_t p = first; p <= page; p++) {
+            markClean(d, p);
+        }
+        page++;
+    }
+    SSD1306_Bus::release();
+}
+
+// Push the dirty parts of the buffer to the panel, blocking until done.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::display()
+{
+    if (buffer == NULL) return;
+    waitForFlush();
+    flush(buffer, dirty, startLine, false);
+}
+
+// Send the logical rectangle x, y, w, h as it appears at the current
+// rotation, whether it is marked dirty or not, and nothing else.  The
+// window is whole pages tall, so a 30x16 area costs 60 bytes when it sits
+// on page boundaries.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::displayRegion(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    // clip to the logical screen
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > _width) w = _width - x;
+    if (y + h > _height) h = _height - y;
+    if (w <= 0 || h <= 0) return;
+
+    // and map to panel coordinates, as drawPixel() does
+    int16_t x0, y0, rw = w, rh = h;
+    switch (getRotation()) {
+    case 1:
+        x0 = W - y - h;
+        y0 = x;
+        rw = h;
+        rh = w;
+        break;
+    case 2:
+        x0 = W - x - w;
+        y0 = H - y - h;
+        break;
+    case 3:
+        x0 = y;
+        y0 = H - x - w;
+        rw = h;
+        rh = w;
+        break;
+    default:
+        x0 = x;
+        y0 = y;
+        break;
+    }
+
+    flushWindow(x0, x0 + rw - 1, y0 / 8, (y0 + rh - 1) / 8);
+}
+
+// Send pages first..last in full
+SSD1306_TEMPLATE
+void SSD1306_PANEL::displayPages(uint8_t first, uint8_t last)
+{
+    if (last >= PAGES) last = PAGES - 1;
+    if (first > last) return;
+    flushWindow(0, W - 1, first, last);
+}
+
+// Send columns x0..x1 of pages first..last through the usual flush, so
+// diff mode, scrolling and the bus scheduler all apply, then drop whatever
+// dirty ranges the window covered.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::flushWindow(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last)
+{
+    if (buffer == NULL) return;
+    waitForFlush();
+
+    DirtyMap window;
+    for (uint8_t page = 0; page < PAGES; page++) {
+        markClean(window, page);
+    }
+    for (uint8_t page = first; page <= last; page++) {
+        window.min[page] = x0;
+        window.max[page] = x1;
+    }
+    flush(buffer, window, startLine, false);
+
+    for (uint8_t page = first; page <= last; page++) {
+        if (!isScrolling(page) && dirty.min[page] >= x0 && dirty.max[page] <= x1) {
+            markClean(dirty, page);
+        }
+    }
+}
+
+// Hand the current buffer to the flush fiber and return straight away.
+// Drawing carries on in the other buffer, which starts out as a copy of the
+// frame being sent.  If a flush is already running this waits for it first.
+// The second buffer is allocated on first use; if that fails this falls
+// back to a blocking display().
+SSD1306_TEMPLATE
+void SSD1306_PANEL::displayAsync()
+{
+    if (buffer == NULL) return;
+    waitForFlush();
+
+    if (spare == NULL) {
+        // same layout as buffer: word aligned, spare word in front
+        char *p = (char *) malloc(FRAMESIZE);
+        if (p == NULL) {
+            display();
+            return;
+        }
+        spare = p + 4;
+    }
+
+    sendDirty = dirty;
+    for (uint8_t page = 0; page < PAGES; page++) {
+        markClean(dirty, page);
+    }
+
+    sendStartLine = startLine;
+    sending = buffer;
+    buffer = spare;
+    spare = sending;
+    memcpy(buffer, sending, BUFSIZE);
+
+#ifdef SSD1306_HOST
+    flush(sending, sendDirty, sendStartLine, false);
+#else
+    if (!flushFiberStarted) {
+        flushFiberStarted = true;
+        create_fiber(SSD1306_PANEL::flushFiber, this);
+    }
+
+    flushing = true;
+    MicroBitEvent(SSD1306_ID, SSD1306_EVT_FLUSH);
+#endif
+}
+
+// True while the flush fiber is still sending a frame from displayAsync()
+SSD1306_TEMPLATE
+bool SSD1306_PANEL::isFlushing(void)
+{
+    return flushing;
+}
+
+// Block the calling fiber until the flush fiber is idle
+SSD1306_TEMPLATE
+void SSD1306_PANEL::waitForFlush(void)
+{
+#ifndef SSD1306_HOST
+    while (flushing) {
+        fiber_wait_for_event(SSD1306_ID, SSD1306_EVT_FLUSH_DONE);
+    }
+#endif
+}
+
+#ifndef SSD1306_HOST
+SSD1306_TEMPLATE
+void SSD1306_PANEL::flushFiber(void *param)
+{
+    SSD1306_PANEL *oled = (SSD1306_PANEL *) param;
+
+    while (true) {
+        if (!oled->flushing) {
+            fiber_wait_for_event(SSD1306_ID, SSD1306_EVT_FLUSH);
+            continue;
+        }
+        oled->flush(oled->sending, oled->sendDirty, oled->sendStartLine, true);
+        oled->flushing = false;
+        MicroBitEvent(SSD1306_ID, SSD1306_EVT_FLUSH_DONE);
+    }
+}
+#endif
+
+// The buffer drawing currently goes to, PAGES rows of W column bytes.
+// With displayAsync() this changes on every call.
+SSD1306_TEMPLATE
+uint8_t *SSD1306_PANEL::getBuffer(void)
+{
+    return (uint8_t *) buffer;
+}
+
+// Forget what the panel holds; the next display() sends the whole buffer.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::invalidate(void)
+{
+    markDirtyPages(0, PAGES - 1, 0, W - 1);
+    shadowValid = 0;
+}
+
+// False, leaving the panel alone, if there is no buffer because it
+// couldn't be allocated
+SSD1306_TEMPLATE
+bool SSD1306_PANEL::init()
+{
+    if (buffer == NULL) return false;
+    waitForFlush();
 
     // Reset Display
-    micro.io.P0.setDigitalValue(1);
-    micro.sleep(10);
-    micro.io.P0.setDigitalValue(0);
-    micro.sleep(10);
-    micro.io.P0.setDigitalValue(1);
-    micro.sleep(100);
+    transport.reset();
 
     // Init sequence
-    ssd1306_command(SSD1306_DISPLAYOFF);                    // 0xAE
-    ssd1306_command(SSD1306_SETDISPLAYCLOCKDIV);            // 0xD5
-    ssd1306_command(0x80);                                  // the suggested ratio 0x80
+    char seq[SSD1306_INIT_LEN];
+    uint8_t n = ssd1306_initSequence(seq, H, COMPINS);
+    beginCommands();
+    for (uint8_t i = 0; i < n; i++) {
+        ssd1306_command(seq[i]);
+    }
+    commitCommands();
+    panelStartLine = 0;
+    scrollDir = 0;
+
+    // panel RAM is undefined after reset
+    invalidate();
+    return true;
+}
 
-    ssd1306_command(SSD1306_SETMULTIPLEX);                  // 0xA8
-    ssd1306_command(SSD1306_LCDHEIGHT - 1);
+// Run stmt with V the view for the current rotation and v one on this
+// panel, so the rotation is looked at once per call rather than per pixel
+#define SSD1306_ROTATED(stmt) \
+  switch (rotation) { \
+  case 0: { typedef View<0> V; V v(*this); stmt; break; } \
+  case 1: { typedef View<1> V; V v(*this); stmt; break; } \
+  case 2: { typedef View<2> V; V v(*this); stmt; break; } \
+  case 3: { typedef View<3> V; V v(*this); stmt; break; } \
+  }
 
-    ssd1306_command(SSD1306_SETDISPLAYOFFSET);              // 0xD3
-    ssd1306_command(0x0);                                   // no offset
-    ssd1306_command(SSD1306_SETSTARTLINE | 0x0);            // line #0
-    ssd1306_command(SSD1306_CHARGEPUMP);                    // 0x8D
-    ssd1306_command(0x14);
+// The same with the rotation left to each span
+#define SSD1306_SPANS(stmt) \
+  { typedef View<4> V; V v(*this); stmt; }
 
-    ssd1306_command(SSD1306_MEMORYMODE);                    // 0x20
-    ssd1306_command(0x00);                                  // 0x0 act like ks0108
-    ssd1306_command(SSD1306_SEGREMAP | 0x1);
-    ssd1306_command(SSD1306_COMSCANDEC);
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  (this->*rotated->plot)(x, y, color);
+}
 
-    ssd1306_command(SSD1306_SETCOMPINS);                    // 0xDA
-    ssd1306_command(0x12);
-    ssd1306_command(SSD1306_SETCONTRAST);                   // 0x81
-    ssd1306_command(0xCF);
+SSD1306_TEMPLATE template <uint8_t R>
+void SSD1306_PANEL::plotAt(int16_t x, int16_t y, uint16_t color) {
+  View<R>(*this).plot(x, y, color);
+}
+
+SSD1306_TEMPLATE template <uint8_t R>
+void SSD1306_PANEL::hspanAt(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  View<R>(*this).hspan(x, y, w, color);
+}
 
-    ssd1306_command(SSD1306_SETPRECHARGE);                  // 0xd9
-    ssd1306_command(0xF1);
-    ssd1306_command(SSD1306_SETVCOMDETECT);                 // 0xDB
-    ssd1306_command(0x40);
-    ssd1306_command(SSD1306_DISPLAYALLON_RESUME);           // 0xA4
-    ssd1306_command(SSD1306_NORMALDISPLAY);                 // 0xA6
+SSD1306_TEMPLATE template <uint8_t R>
+void SSD1306_PANEL::vspanAt(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  View<R>(*this).vspan(x, y, h, color);
+}
 
-    ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
+SSD1306_TEMPLATE
+const typename SSD1306_PANEL::Spans SSD1306_PANEL::spans[4] = {
+  { &SSD1306_PANEL::plotAt<0>, &SSD1306_PANEL::hspanAt<0>, &SSD1306_PANEL::vspanAt<0> },
+  { &SSD1306_PANEL::plotAt<1>, &SSD1306_PANEL::hspanAt<1>, &SSD1306_PANEL::vspanAt<1> },
+  { &SSD1306_PANEL::plotAt<2>, &SSD1306_PANEL::hspanAt<2>, &SSD1306_PANEL::vspanAt<2> },
+  { &SSD1306_PANEL::plotAt<3>, &SSD1306_PANEL::hspanAt<3>, &SSD1306_PANEL::vspanAt<3> }
+};
 
-    ssd1306_command(SSD1306_DISPLAYON);//--turn on oled panel
+SSD1306_TEMPLATE
+void SSD1306_PANEL::setRotation(uint8_t r) {
+  Adafruit_GFX::setRotation(r);
+  rotated = &spans[rotation];
 }
 
-void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
-  if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
+SSD1306_TEMPLATE
+inline void SSD1306_PANEL::rawPixel(int16_t x, int16_t y, uint16_t color) {
+  if ((x < 0) || (x >= W) || (y < 0) || (y >= H))
     return;
 
-  // check rotation, move pixel around if necessary
-  switch (getRotation()) {
-  case 1:
-    ssd1306_swap(x, y);
-    x = WIDTH - x - 1;
-    break;
-  case 2:
-    x = WIDTH - x - 1;
-    y = HEIGHT - y - 1;
-    break;
-  case 3:
-    ssd1306_swap(x, y);
-    y = HEIGHT - y - 1;
-    break;
-  }
+  markDirty(y/8, x, x);
+  SSD1306_PERF_ADD(pixels, 1);
 
   // x is which column
     switch (color)
     {
-      case WHITE:   buffer[x+ (y/8)*SSD1306_LCDWIDTH] |=  (1 << (y&7)); break;
-      case BLACK:   buffer[x+ (y/8)*SSD1306_LCDWIDTH] &= ~(1 << (y&7)); break;
-      case INVERSE: buffer[x+ (y/8)*SSD1306_LCDWIDTH] ^=  (1 << (y&7)); break;
+      case WHITE:   buffer[x+ (y/8)*W] |=  (1 << (y&7)); break;
+      case BLACK:   buffer[x+ (y/8)*W] &= ~(1 << (y&7)); break;
+      case INVERSE: buffer[x+ (y/8)*W] ^=  (1 << (y&7)); break;
+    }
+
+}
+
+// Rotation 1 is 90 degrees: swap x & y, then invert x.  2 inverts both,
+// 3 swaps and inverts y.  Spans are moved back by their length where the
+// inverted axis runs the other way.
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::plot(int16_t x, int16_t y, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.rawPixel(x, y, color); break;
+  case 1: panel.rawPixel(W - 1 - y, x, color); break;
+  case 2: panel.rawPixel(W - 1 - x, H - 1 - y, color); break;
+  case 3: panel.rawPixel(y, H - 1 - x, color); break;
+  }
+}
+
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::hspan(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.drawFastHLineInternal(x, y, w, color); break;
+  case 1: panel.drawFastVLineInternal(W - 1 - y, x, w, color); break;
+  case 2: panel.drawFastHLineInternal(W - x - w, H - 1 - y, w, color); break;
+  case 3: panel.drawFastVLineInternal(y, H - x - w, w, color); break;
+  }
+}
+
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::vspan(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.drawFastVLineInternal(x, y, h, color); break;
+  case 1: panel.drawFastHLineInternal(W - y - h, x, h, color); break;
+  case 2: panel.drawFastVLineInternal(W - 1 - x, H - y - h, h, color); break;
+  case 3: panel.drawFastHLineInternal(y, H - 1 - x, h, color); break;
+  }
+}
+
+// Spans already known to be on screen, written without clipping or
+// marking anything dirty; the caller marks the area it drew once
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::hrun(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.fillRow(x, y, w, color); break;
+  case 1: panel.fillColumn(W - 1 - y, x, w, color); break;
+  case 2: panel.fillRow(W - x - w, H - 1 - y, w, color); break;
+  case 3: panel.fillColumn(y, H - x - w, w, color); break;
+  }
+}
+
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::vrun(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.fillColumn(x, y, h, color); break;
+  case 1: panel.fillRow(W - y - h, x, h, color); break;
+  case 2: panel.fillColumn(W - 1 - x, H - y - h, h, color); break;
+  case 3: panel.fillRow(y, H - 1 - x, h, color); break;
+  }
+}
+
+// Mark the on screen rectangle x0, y0 to x1, y1 (inclusive) dirty
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::mark(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.markDirtyPages(y0 / 8, y1 / 8, x0, x1); break;
+  case 1: panel.markDirtyPages(x0 / 8, x1 / 8, W - 1 - y1, W - 1 - y0); break;
+  case 2: panel.markDirtyPages((H - 1 - y1) / 8, (H - 1 - y0) / 8, W - 1 - x1, W - 1 - x0); break;
+  case 3: panel.markDirtyPages((H - 1 - x1) / 8, (H - 1 - x0) / 8, y0, y1); break;
+  }
+}
+
+SSD1306_TEMPLATE template <uint8_t R>
+inline void SSD1306_PANEL::View<R>::fill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  switch (R < 4 ? R : panel.rotation) {
+  case 0: panel.fillBox(x, y, w, h, color); break;
+  case 1: panel.fillBox(W - y - h, x, h, w, color); break;
+  case 2: panel.fillBox(W - x - w, H - y - h, w, h, color); break;
+  case 3: panel.fillBox(y, H - x - w, h, w, color); break;
+  }
+}
+
+// Largest text size with a scaled glyph cached
+#define SSD1306_GLYPH_MAX_SIZE 4
+
+#if SSD1306_GLYPH_CACHE > 0
+// A font nibble with each bit repeated 2, 3 or 4 times
+static const uint16_t glyphSpread[3][16] = {
+  { 0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF },
+  { 0x000, 0x007, 0x038, 0x03F, 0x1C0, 0x1C7, 0x1F8, 0x1FF,
+    0xE00, 0xE07, 0xE38, 0xE3F, 0xFC0, 0xFC7, 0xFF8, 0xFFF },
+  { 0x0000, 0x000F, 0x00F0, 0x00FF, 0x0F00, 0x0F0F, 0x0FF0, 0x0FFF,
+    0xF000, 0xF00F, 0xF0F0, 0xF0FF, 0xFF00, 0xFF0F, 0xFFF0, 0xFFFF }
+};
+
+// A glyph scaled vertically: size bytes per font column, top page first
+struct SSD1306_Glyph {
+  unsigned char c;
+  uint8_t size;  // 0 when the entry is empty
+  uint16_t used; // glyphClock when last drawn
+  uint8_t columns[5 * SSD1306_GLYPH_MAX_SIZE];
+};
+
+static SSD1306_Glyph glyphCache[SSD1306_GLYPH_CACHE];
+static uint16_t glyphClock;
+#endif
+
+// Columns of character c at size, from the cache, scaling it into the
+// least recently used entry if it isn't there; NULL if it can't be cached
+static const uint8_t *ssd1306_scaledGlyph(const unsigned char *font, unsigned char c, uint8_t size) {
+#if SSD1306_GLYPH_CACHE > 0
+  if (size > SSD1306_GLYPH_MAX_SIZE) return NULL;
+
+  if (++glyphClock == 0) {
+    // start the ages over rather than let them wrap
+    for (uint8_t i = 0; i < SSD1306_GLYPH_CACHE; i++) glyphCache[i].used = 0;
+    glyphClock = 1;
+  }
+
+  SSD1306_Glyph *victim = glyphCache;
+  for (SSD1306_Glyph *e = glyphCache; e < glyphCache + SSD1306_GLYPH_CACHE; e++) {
+    if (e->c == c && e->size == size) {
+      e->used = glyphClock;
+      return e->columns;
     }
+    if (e->used < victim->used) victim = e;
+  }
 
+  victim->c = c;
+  victim->size = size;
+  victim->used = glyphClock;
+  const uint16_t *spread = glyphSpread[size - 2];
+  uint8_t *out = victim->columns;
+  for (uint8_t col = 0; col < 5; col++) {
+    uint32_t bits = spread[font[col] & 0x0F] | ((uint32_t) spread[font[col] >> 4] << (4 * size));
+    for (uint8_t k = 0; k < size; k++) {
+      *out++ = bits >> (8 * k);
+    }
+  }
+  return victim->columns;
+#else
+  return NULL;
+#endif
+}
+
+// Apply color to the bits of *p set in bits
+static inline void ssd1306_paint(char *p, uint8_t bits, uint16_t color) {
+  switch (color)
+  {
+    case WHITE:   *p |=  bits; break;
+    case BLACK:   *p &= ~bits; break;
+    case INVERSE: *p ^=  bits; break;
+  }
 }
 
-void Adafruit_SSD1306::invertDisplay(uint8_t i) {
+// The font is stored as columns with bit 0 at the top, which is how a
+// page byte is laid out, so a glyph column is one byte write when y is a
+// multiple of 8 and a shifted write into two pages otherwise.  Larger
+// sizes come from the scaled glyph cache.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawChar(int16_t x, int16_t y, unsigned char c,
+                             uint16_t color, uint16_t bg, uint8_t size) {
+  const uint8_t *scaled = NULL;
+  if (getRotation() != 0 ||
+      (size > 1 && (scaled = ssd1306_scaledGlyph(glyph(c), c, size)) == NULL)) {
+    SSD1306_ROTATED(SSD1306_Render<V>::character(v, x, y, glyph(c), color, bg, size));
+    return;
+  }
+  SSD1306_PERF_CALL(SSD1306_PERF_CHAR);
+
+  if (scaled) {
+    drawScaledGlyph(x, y, scaled, color, bg, size);
+    return;
+  }
+
+  if ((x >= W) || (y >= H) || (x + 6 <= 0) || (y + 8 <= 0))
+    return;
+
+  int16_t x0 = (x < 0) ? 0 : x;
+  int16_t x1 = (x + 6 > W) ? W : x + 6;
+  int8_t page = y >> 3; // -1 when the glyph starts above the screen
+  uint8_t shift = y & 7;
+  bool top = page >= 0;
+  bool bottom = shift && page + 1 < PAGES;
+  bool opaque = bg != color;
+
+  if (top) markDirty(page, x0, x1 - 1);
+  if (bottom) markDirty(page + 1, x0, x1 - 1);
+
+  const unsigned char *g = glyph(c);
+  int16_t row = page * W;
+  for (int16_t i = x0; i < x1; i++) {
+    uint16_t line = ((i - x < 5) ? g[i - x] : 0) << shift;
+    uint16_t clear = (0xFF << shift) & ~line;
+    if (top) {
+      ssd1306_paint(buffer + row + i, line, color);
+      if (opaque) ssd1306_paint(buffer + row + i, clear, bg);
+    }
+    if (bottom) {
+      ssd1306_paint(buffer + row + W + i, line >> 8, color);
+      if (opaque) ssd1306_paint(buffer + row + W + i, clear >> 8, bg);
+    }
+  }
+}
+
+// A glyph column scaled to size bytes lands in size pages when y is a
+// multiple of 8 and is shifted across size + 1 otherwise
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawScaledGlyph(int16_t x, int16_t y, const uint8_t *columns,
+                                    uint16_t color, uint16_t bg, uint8_t size) {
+  if ((x >= W) || (y >= H) || (x + 6 * size <= 0) || (y + 8 * size <= 0))
+    return;
+
+  int16_t x0 = (x < 0) ? 0 : x;
+  int16_t x1 = (x + 6 * size > W) ? W : x + 6 * size;
+  int8_t first = y >> 3; // negative when the glyph starts above the screen
+  uint8_t shift = y & 7;
+  uint8_t bands = shift ? size + 1 : size;
+
+  // each color as masks for *p = ((*p | set) & ~clear) ^ flip, so a byte
+  // takes both colors in one write; no background is no masks
+  uint8_t fgSet = (color == WHITE) ? 0xFF : 0, fgClear = (color == BLACK) ? 0xFF : 0;
+  uint8_t fgFlip = (color == INVERSE) ? 0xFF : 0;
+  uint8_t bgSet = 0, bgClear = 0, bgFlip = 0;
+  if (bg != color) {
+    bgSet = (bg == WHITE) ? 0xFF : 0;
+    bgClear = (bg == BLACK) ? 0xFF : 0;
+    bgFlip = (bg == INVERSE) ? 0xFF : 0;
+  }
+
+  for (uint8_t k = 0; k < bands; k++) {
+    int8_t page = first + k;
+    if (page < 0 || page >= PAGES) continue;
+    markDirty(page, x0, x1 - 1);
+
+    // rows of this page the glyph covers
+    uint8_t mask = 0xFF;
+    if (k == 0) mask <<= shift;
+    if (k == size) mask >>= 8 - shift;
+
+    char *row = buffer + page * W;
+    for (uint8_t col = 0; col < 6; col++) {
+      int16_t c0 = x + col * size, c1 = c0 + size;
+      if (c0 < x0) c0 = x0;
+      if (c1 > x1) c1 = x1;
+      if (c0 >= c1) continue;
+
+      // this page's byte of the column: the low part of byte k and the
+      // spill from byte k - 1
+      uint8_t bits = 0;
+      if (col < 5) {
+        const uint8_t *src = columns + col * size;
+        if (k < size) bits = src[k] << shift;
+        if (k > 0 && shift) bits |= src[k - 1] >> (8 - shift);
+      }
+      uint8_t off = mask & ~bits;
+      uint8_t set = (bits & fgSet) | (off & bgSet);
+      uint8_t clear = ~((bits & fgClear) | (off & bgClear));
+      uint8_t flip = (bits & fgFlip) | (off & bgFlip);
+      for (int16_t i = c0; i < c1; i++) {
+        row[i] = ((row[i] | set) & clear) ^ flip;
+      }
+    }
+  }
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::invertDisplay(uint8_t i) {
+  beginCommands();
   if (i) {
     ssd1306_command(SSD1306_INVERTDISPLAY);
   } else {
     ssd1306_command(SSD1306_NORMALDISPLAY);
   }
+  commitCommands();
 }
 
 
 
 
 
+// Panel frames per scroll step, indexed by the scroll interval setting
+static const uint16_t scrollIntervals[8] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+#ifdef SSD1306_HOST
+#include <time.h>
+static uint32_t ssd1306_millis(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#else
+#define ssd1306_millis() system_timer_current_time()
+#endif
+
+// Hardware scrolling
+// The controller moves its own RAM while scrolling, so the driver keeps
+// track of where the panel has got to: it sends anything pending for the
+// scrolled pages before starting, leaves them alone in display() while the
+// scroll runs, and estimates the number of steps taken from the time
+// elapsed, the frame period and the programmed interval.  stopscroll()
+// then either resends the pages from the buffer, snapping the image back,
+// or first rotates the buffer by the estimated steps so the image stays
+// where it scrolled to.  The estimate can be a step out; resending the
+// pages either way keeps buffer and panel in step afterwards.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::beginScroll(uint8_t start, uint8_t stop, uint8_t interval, int8_t dir)
+{
+  if (scrollDir) stopscroll();
+  display();
+
+  scrollFirst = start & 7;
+  scrollLast = ((stop & 7) < PAGES) ? (stop & 7) : PAGES - 1;
+  scrollInterval = interval & 7;
+  scrollDir = dir;
+  scrollStart = ssd1306_millis();
+}
+
+// Frame period the step estimate uses, in microseconds.  Defaults to
+// SSD1306_FRAME_US(H); set it from a measurement for a closer estimate.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::setFramePeriod(uint32_t us)
+{
+  framePeriod = us ? us : 1;
+}
+
+// Estimated scroll steps the panel has taken since the scroll started
+SSD1306_TEMPLATE
+uint32_t SSD1306_PANEL::scrollSteps(void)
+{
+  if (!scrollDir) return 0;
+  uint32_t elapsed = ssd1306_millis() - scrollStart;
+  return (uint64_t) elapsed * 1000 / ((uint32_t) framePeriod * scrollIntervals[scrollInterval]);
+}
+
 // startscrollright
-// Activate a right handed scroll for rows start through stop
-// Hint, the display is 16 rows tall. To scroll the whole display, run:
-// display.scrollright(0x00, 0x0F)
-void Adafruit_SSD1306::startscrollright(uint8_t start, uint8_t stop){
+// Activate a right handed scroll for pages start through stop
+// Hint, the display is 8 pages tall. To scroll the whole display, run:
+// display.startscrollright(0x00, 0x07)
+SSD1306_TEMPLATE
+void SSD1306_PANEL::startscrollright(uint8_t start, uint8_t stop, uint8_t interval){
+  beginScroll(start, stop, interval, 1);
+  beginCommands();
   ssd1306_command(SSD1306_RIGHT_HORIZONTAL_SCROLL);
   ssd1306_command(0X00);
   ssd1306_command(start);
-  ssd1306_command(0X00);
+  ssd1306_command(interval);
   ssd1306_command(stop);
   ssd1306_command(0X00);
   ssd1306_command(0XFF);
   ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+  commitCommands();
 }
 
 // startscrollleft
-// Activate a right handed scroll for rows start through stop
-// Hint, the display is 16 rows tall. To scroll the whole display, run:
-// display.scrollright(0x00, 0x0F)
-void Adafruit_SSD1306::startscrollleft(uint8_t start, uint8_t stop){
+// Activate a left handed scroll for pages start through stop
+// Hint, the display is 8 pages tall. To scroll the whole display, run:
+// display.startscrollleft(0x00, 0x07)
+SSD1306_TEMPLATE
+void SSD1306_PANEL::startscrollleft(uint8_t start, uint8_t stop, uint8_t interval){
+  beginScroll(start, stop, interval, -1);
+  beginCommands();
   ssd1306_command(SSD1306_LEFT_HORIZONTAL_SCROLL);
   ssd1306_command(0X00);
   ssd1306_command(start);
-  ssd1306_command(0X00);
+  ssd1306_command(interval);
   ssd1306_command(stop);
   ssd1306_command(0X00);
   ssd1306_command(0XFF);
   ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+  commitCommands();
 }
 
 // startscrolldiagright
-// Activate a diagonal scroll for rows start through stop
-// Hint, the display is 16 rows tall. To scroll the whole display, run:
-// display.scrollright(0x00, 0x0F)
-void Adafruit_SSD1306::startscrolldiagright(uint8_t start, uint8_t stop){
+// Activate a diagonal scroll for pages start through stop
+// Hint, the display is 8 pages tall. To scroll the whole display, run:
+// display.startscrolldiagright(0x00, 0x07)
+SSD1306_TEMPLATE
+void SSD1306_PANEL::startscrolldiagright(uint8_t start, uint8_t stop, uint8_t interval){
+  beginScroll(start, stop, interval, 1);
+  beginCommands();
   ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
   ssd1306_command(0X00);
-  ssd1306_command(SSD1306_LCDHEIGHT);
+  ssd1306_command(H);
   ssd1306_command(SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL);
   ssd1306_command(0X00);
   ssd1306_command(start);
-  ssd1306_command(0X00);
+  ssd1306_command(interval);
   ssd1306_command(stop);
   ssd1306_command(0X01);
   ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+  commitCommands();
 }
 
 // startscrolldiagleft
-// Activate a diagonal scroll for rows start through stop
-// Hint, the display is 16 rows tall. To scroll the whole display, run:
-// display.scrollright(0x00, 0x0F)
-void Adafruit_SSD1306::startscrolldiagleft(uint8_t start, uint8_t stop){
+// Activate a diagonal scroll for pages start through stop
+// Hint, the display is 8 pages tall. To scroll the whole display, run:
+// display.startscrolldiagleft(0x00, 0x07)
+SSD1306_TEMPLATE
+void SSD1306_PANEL::startscrolldiagleft(uint8_t start, uint8_t stop, uint8_t interval){
+  beginScroll(start, stop, interval, -1);
+  beginCommands();
   ssd1306_command(SSD1306_SET_VERTICAL_SCROLL_AREA);
   ssd1306_command(0X00);
-  ssd1306_command(SSD1306_LCDHEIGHT);
+  ssd1306_command(H);
   ssd1306_command(SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL);
   ssd1306_command(0X00);
   ssd1306_command(start);
-  ssd1306_command(0X00);
+  ssd1306_command(interval);
   ssd1306_command(stop);
   ssd1306_command(0X01);
   ssd1306_command(SSD1306_ACTIVATE_SCROLL);
+  commitCommands();
 }
 
-void Adafruit_SSD1306::stopscroll(void){
+// Stop scrolling.  With follow set, the buffer is rotated to where the
+// panel has scrolled to (horizontally; the vertical part of a diagonal
+// scroll ends with the scroll).  That needs the panel's RAM to be exactly
+// as wide as the buffer, so on narrower panels the image always snaps back.
+// Either way the scrolled pages go out again on the next display().
+SSD1306_TEMPLATE
+void SSD1306_PANEL::stopscroll(bool follow){
+  uint32_t steps = scrollSteps();
   ssd1306_command(SSD1306_DEACTIVATE_SCROLL);
+  if (!scrollDir) return;
+
+  if (follow && W == SSD1306_LCDWIDTH) {
+    waitForFlush();
+    uint8_t n = steps % W;
+    if (n && scrollDir < 0) n = W - n;
+    if (n) {
+      char row[W];
+      for (uint8_t page = scrollFirst; page <= scrollLast; page++) {
+        char *p = buffer + page * W;
+        // rotate right by n
+        memcpy(row, p + W - n, n);
+        memmove(p + n, p, W - n);
+        memcpy(p, row, n);
+      }
+    }
+  }
+
+  for (uint8_t page = scrollFirst; page <= scrollLast; page++) {
+    markDirty(page, 0, W - 1);
+    shadowValid &= ~(1 << page);
+  }
+  scrollDir = 0;
 }
 
 // Dim the display
 // dim = true: display is dimmed
 // dim = false: display is normal
-void Adafruit_SSD1306::dim(bool dim) {
+SSD1306_TEMPLATE
+void SSD1306_PANEL::dim(bool dim) {
   uint8_t contrast;
 
   if (dim) {
@@ -293,53 +1278,116 @@ void Adafruit_SSD1306::dim(bool dim) {
   }
   // the range of contrast to too small to be really useful
   // it is useful to dim the display
+  beginCommands();
   ssd1306_command(SSD1306_SETCONTRAST);
   ssd1306_command(contrast);
+  commitCommands();
 }
 
 
 // clear everything
-void Adafruit_SSD1306::clearDisplay(void) {
-  memset(buffer, 0, (SSD1306_LCDWIDTH*SSD1306_LCDHEIGHT/8));
+SSD1306_TEMPLATE
+void SSD1306_PANEL::clearDisplay(void) {
+  memset(buffer, 0, (BUFSIZE));
+  markDirtyPages(0, PAGES - 1, 0, W - 1);
 }
 
-void Adafruit_SSD1306::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
-  bool bSwap = false;
-  switch(rotation) {
-    case 0:
-      // 0 degree rotation, do nothing
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x
-      bSwap = true;
-      ssd1306_swap(x, y);
-      x = WIDTH - x - 1;
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = WIDTH - x - 1;
-      y = HEIGHT - y - 1;
-      x -= (w-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y  and adjust y for w (not to become h)
-      bSwap = true;
-      ssd1306_swap(x, y);
-      y = HEIGHT - y - 1;
-      y -= (w-1);
-      break;
+// Turn console mode on (clearing the screen, cursor at the top left) or
+// off (leaving the text where it is on screen).  Needs the panel to use
+// all 64 rows of its RAM, so that moving the start line wraps around
+// exactly the rows in the buffer; returns false on other panels.
+SSD1306_TEMPLATE
+bool SSD1306_PANEL::setConsole(bool enable)
+{
+  if (H != 64) return false;
+  if (enable == console) return true;
+
+  if (enable) {
+    setRotation(0);
+    clearDisplay();
+    setCursor(0, 0);
+    consoleTop = 0;
+    consoleNewline = false;
+  } else if (consoleTop) {
+    // unroll the ring so the top line is back in page 0
+    waitForFlush();
+    char row[W];
+    for (uint8_t n = 0; n < consoleTop; n++) {
+      memcpy(row, buffer, W);
+      memmove(buffer, buffer + W, BUFSIZE - W);
+      memcpy(buffer + BUFSIZE - W, row, W);
+    }
+    markDirtyPages(0, PAGES - 1, 0, W - 1);
+    consoleTop = 0;
   }
+  startLine = 0;
+  console = enable;
+  return true;
+}
 
-  if(bSwap) {
-    drawFastVLineInternal(x, y, w, color);
-  } else {
-    drawFastHLineInternal(x, y, w, color);
+// Move to the next line, scrolling the ring by one line if the cursor is
+// already on the last one.  The line scrolled in is cleared in the buffer;
+// display() sends it together with the new start line.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::consoleLineFeed(void)
+{
+  uint8_t lineH = textsize * 8;
+
+  cursor_x = 0;
+  if (cursor_y + 2 * lineH <= _height) {
+    cursor_y += lineH;
+    return;
+  }
+
+  consoleTop = (consoleTop + textsize) % PAGES;
+  for (uint8_t n = 0; n < textsize; n++) {
+    uint8_t page = (consoleTop + cursor_y / 8 + n) % PAGES;
+    memset(buffer + page * W, 0, W);
+    markDirty(page, 0, W - 1);
   }
+  startLine = consoleTop * 8;
 }
 
-void Adafruit_SSD1306::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) {
+SSD1306_TEMPLATE
+uint8_t SSD1306_PANEL::write(uint8_t c)
+{
+  if (!console) return Adafruit_GFX::write(c);
+
+  if (c == '\n') {
+    // wait for the next character, so a trailing newline doesn't cost a
+    // scroll and a blank page
+    if (consoleNewline) consoleLineFeed();
+    consoleNewline = true;
+  } else if (c != '\r') {
+    if (consoleNewline) {
+      consoleLineFeed();
+      consoleNewline = false;
+    }
+    if (wrap && cursor_x > _width - textsize * 6) {
+      consoleLineFeed();
+    }
+
+    // where the cursor line is in the ring; a line that wraps past the
+    // end of the buffer is drawn a second time one screen up
+    int16_t y = (cursor_y + consoleTop * 8) % H;
+    drawChar(cursor_x, y, c, textcolor, textbgcolor, textsize);
+    if (y + textsize * 8 > H) {
+      drawChar(cursor_x, y - H, c, textcolor, textbgcolor, textsize);
+    }
+    cursor_x += textsize * 6;
+  }
+  return 1;
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  (this->*rotated->hspan)(x, y, w, color);
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) {
   // Do bounds/limit checks
-  if(y < 0 || y >= HEIGHT) { return; }
+  if(y < 0 || y >= H) { return; }
 
   // make sure we don't try to draw below 0
   if(x < 0) {
@@ -348,17 +1396,27 @@ void Adafruit_SSD1306::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, ui
   }
 
   // make sure we don't go off the edge of the display
-  if( (x + w) > WIDTH) {
-    w = (WIDTH - x);
+  if( (x + w) > W) {
+    w = (W - x);
   }
 
   // if our width is now negative, punt
   if(w <= 0) { return; }
 
+  markDirty(y/8, x, x + w - 1);
+  fillRow(x, y, w, color);
+}
+
+// A row of w pixels on the panel, already clipped
+SSD1306_TEMPLATE
+inline void SSD1306_PANEL::fillRow(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  SSD1306_PERF_ADD(spans, 1);
+  SSD1306_PERF_ADD(spanPixels, w);
+
   // set up the pointer for  movement through the buffer
   register char *pBuf = buffer;
   // adjust the buffer pointer for the current row
-  pBuf += ((y/8) * SSD1306_LCDWIDTH);
+  pBuf += ((y/8) * W);
   // and offset x columns in
   pBuf += x;
 
@@ -372,44 +1430,17 @@ void Adafruit_SSD1306::drawFastHLineInternal(int16_t x, int16_t y, int16_t w, ui
   }
 }
 
-void Adafruit_SSD1306::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
-  bool bSwap = false;
-  switch(rotation) {
-    case 0:
-      break;
-    case 1:
-      // 90 degree rotation, swap x & y for rotation, then invert x and adjust x for h (now to become w)
-      bSwap = true;
-      ssd1306_swap(x, y);
-      x = WIDTH - x - 1;
-      x -= (h-1);
-      break;
-    case 2:
-      // 180 degree rotation, invert x and y - then shift y around for height.
-      x = WIDTH - x - 1;
-      y = HEIGHT - y - 1;
-      y -= (h-1);
-      break;
-    case 3:
-      // 270 degree rotation, swap x & y for rotation, then invert y
-      bSwap = true;
-      ssd1306_swap(x, y);
-      y = HEIGHT - y - 1;
-      break;
-  }
-
-  if(bSwap) {
-    drawFastHLineInternal(x, y, h, color);
-  } else {
-    drawFastVLineInternal(x, y, h, color);
-  }
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  (this->*rotated->vspan)(x, y, h, color);
 }
 
 
-void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uint16_t color) {
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h, uint16_t color) {
 
   // do nothing if we're off the left or right side of the screen
-  if(x < 0 || x >= WIDTH) { return; }
+  if(x < 0 || x >= W) { return; }
 
   // make sure we don't try to draw below 0
   if(__y < 0) {
@@ -420,8 +1451,8 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
   }
 
   // make sure we don't go past the height of the display
-  if( (__y + __h) > HEIGHT) {
-    __h = (HEIGHT - __y);
+  if( (__y + __h) > H) {
+    __h = (H - __y);
   }
 
   // if our height is now negative, punt
@@ -429,15 +1460,24 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
     return;
   }
 
+  markDirtyPages(__y/8, (__y + __h - 1)/8, x, x);
+  fillColumn(x, __y, __h, color);
+}
+
+// A column of h pixels on the panel, already clipped
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillColumn(int16_t x, int16_t __y, int16_t __h, uint16_t color) {
   // this display doesn't need ints for coordinates, use local byte registers for faster juggling
   register uint8_t y = __y;
   register uint8_t h = __h;
 
+  SSD1306_PERF_ADD(spans, 1);
+  SSD1306_PERF_ADD(spanPixels, h);
 
   // set up the pointer for fast movement through the buffer
   register char *pBuf = buffer;
   // adjust the buffer pointer for the current row
-  pBuf += ((y/8) * SSD1306_LCDWIDTH);
+  pBuf += ((y/8) * W);
   // and offset x columns in
   pBuf += x;
 
@@ -469,7 +1509,7 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
 
     h -= mod;
 
-    pBuf += SSD1306_LCDWIDTH;
+    pBuf += W;
   }
 
 
@@ -480,7 +1520,7 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
       *pBuf=~(*pBuf);
 
         // adjust the buffer forward 8 rows worth of data
-        pBuf += SSD1306_LCDWIDTH;
+        pBuf += W;
 
         // adjust h & y (there's got to be a faster way for me to do this, but this should still help a fair bit for now)
         h -= 8;
@@ -495,7 +1535,7 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
       *pBuf = val;
 
         // adjust the buffer forward 8 rows worth of data
-        pBuf += SSD1306_LCDWIDTH;
+        pBuf += W;
 
         // adjust h & y (there's got to be a faster way for me to do this, but this should still help a fair bit for now)
         h -= 8;
@@ -520,3 +1560,139 @@ void Adafruit_SSD1306::drawFastVLineInternal(int16_t x, int16_t __y, int16_t __h
   }
 }
 
+// Columns x0..x1 of a word aligned page row: bits are set, cleared or
+// flipped in the end bytes and 4 columns at a time in between, and a full
+// page in WHITE or BLACK is a plain memset
+static void ssd1306_fillRun(char *row, uint8_t x0, uint8_t x1, uint8_t bits, uint16_t color)
+{
+  if (bits == 0xFF && color != INVERSE) {
+    memset(row + x0, (color == WHITE) ? 0xFF : 0, x1 - x0 + 1);
+    return;
+  }
+
+  uint32_t wide = bits * 0x01010101u;
+  uint8_t x = x0;
+  switch (color)
+  {
+    case WHITE:
+      for (; x <= x1 && (x & 3); x++) row[x] |= bits;
+      for (; x + 3 <= x1; x += 4) *(ssd1306_word *)(row + x) |= wide;
+      for (; x <= x1; x++) row[x] |= bits;
+      break;
+    case BLACK:
+      for (; x <= x1 && (x & 3); x++) row[x] &= ~bits;
+      for (; x + 3 <= x1; x += 4) *(ssd1306_word *)(row + x) &= ~wide;
+      for (; x <= x1; x++) row[x] &= ~bits;
+      break;
+    case INVERSE:
+      for (; x <= x1 && (x & 3); x++) row[x] ^= bits;
+      for (; x + 3 <= x1; x += 4) *(ssd1306_word *)(row + x) ^= wide;
+      for (; x <= x1; x++) row[x] ^= bits;
+      break;
+  }
+}
+
+// A filled rectangle on the panel, clipped.  Only the top and bottom
+// pages need a mask, worked out once; every page is then one run along
+// its row.
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillBox(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+
+  int32_t x1 = (int32_t) x + w, y1 = (int32_t) y + h;
+  if (x < 0) x = 0;
+  if (y < 0) y = 0;
+  if (x1 > W) x1 = W;
+  if (y1 > H) y1 = H;
+  if (x >= x1 || y >= y1) return;
+
+  uint8_t first = y / 8, last = (y1 - 1) / 8;
+  uint8_t topMask = 0xFF << (y & 7);
+  uint8_t bottomMask = 0xFF >> (7 - ((y1 - 1) & 7));
+  markDirtyPages(first, last, x, x1 - 1);
+  SSD1306_PERF_ADD(spans, last - first + 1);
+  SSD1306_PERF_ADD(spanPixels, (x1 - x) * (y1 - y));
+
+  char *row = buffer + first * W;
+  for (uint8_t page = first; page <= last; page++, row += W) {
+    uint8_t bits = 0xFF;
+    if (page == first) bits &= topMask;
+    if (page == last)  bits &= bottomMask;
+    ssd1306_fillRun(row, x, x1 - 1, bits, color);
+  }
+}
+
+// The Adafruit_GFX primitives, run through the view for the rotation, or
+// one that reads it per span for those drawn with a few long spans
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  SSD1306_ROTATED(SSD1306_Render<V>::line(v, x0, y0, x1, y1, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  SSD1306_SPANS(SSD1306_Render<V>::rect(v, x, y, w, h, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  SSD1306_SPANS(SSD1306_Render<V>::fillRect(v, x, y, w, h, color));
+}
+
+// The whole screen is the same rectangle at any rotation
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillScreen(uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLSCREEN);
+  fillBox(0, 0, W, H, color);
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  SSD1306_ROTATED(SSD1306_Render<V>::circle(v, x0, y0, r, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  SSD1306_SPANS(SSD1306_Render<V>::fillCircle(v, x0, y0, r, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                 int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_ROTATED(SSD1306_Render<V>::triangle(v, x0, y0, x1, y1, x2, y2, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                 int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_SPANS(SSD1306_Render<V>::fillTriangle(v, x0, y0, x1, y1, x2, y2, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                  int16_t r, uint16_t color) {
+  SSD1306_ROTATED(SSD1306_Render<V>::roundRect(v, x, y, w, h, r, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                  int16_t r, uint16_t color) {
+  SSD1306_SPANS(SSD1306_Render<V>::fillRoundRect(v, x, y, w, h, r, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                               int16_t w, int16_t h, uint16_t color) {
+  SSD1306_ROTATED(SSD1306_Render<V>::bitmap(v, x, y, bitmap, w, h, color));
+}
+
+SSD1306_TEMPLATE
+void SSD1306_PANEL::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                               int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  SSD1306_ROTATED(SSD1306_Render<V>::bitmap(v, x, y, bitmap, w, h, color, bg));
+}
+
+template class Adafruit_SSD1306_Panel<128, 64, SSD1306_COMPINS_ALT>;
+template class Adafruit_SSD1306_Panel<128, 32, SSD1306_COMPINS_SEQ>;
+template class Adafruit_SSD1306_Panel<64, 48, SSD1306_COMPINS_ALT>;
@@ -22,18 +22,54 @@ All text above, and the splash screen must be included in any redistribution
 #define _Adafruit_SSD1306_H_
 
 #include "Adafruit_GFX.h"
-#include "pxt.h"
+#include "SSD1306_Transport.h"
+#include "SSD1306_Perf.h"
 
 #define BLACK 0
 #define WHITE 1
 #define INVERSE 2
 
-#define SSD1306_I2C_ADDRESS     0x7A  // 011110(6bit address)+1(SA0)+0(RW) - 
 #define SSD1306_128_64
 
+// Geometry of the default panel, Adafruit_SSD1306.  Other panels are
+// Adafruit_SSD1306_Panel instantiations, see the typedefs below.
 #define SSD1306_LCDWIDTH 128
 #define SSD1306_LCDHEIGHT 64
 
+// SETCOMPINS values: alternative COM pin config for 64 row panels,
+// sequential for 32 row ones
+#define SSD1306_COMPINS_ALT         0x12
+#define SSD1306_COMPINS_SEQ         0x02
+
+// Approximate bus cost, in data bytes, of setting up one address window.
+// display() merges dirty pages, and in diff mode nearby runs of changed
+// bytes, into one window when that is cheaper.
+#define SSD1306_WINDOW_COST 18
+
+// Nominal panel frame period in microseconds for a panel with the given
+// number of rows, at the clock init() sets up: a ~370kHz oscillator and
+// 66 clocks per row (precharge 0xF1 plus 50)
+#ifndef SSD1306_FRAME_US
+#define SSD1306_FRAME_US(rows) ((uint32_t) (rows) * 66 * 1000000 / 370000)
+#endif
+
+// Largest number of command bytes packed into one I2C write by a batch
+#define SSD1306_CMD_BATCH_MAX 32
+
+// Text sizes 2 to 4 are drawn from glyphs scaled once and kept in a cache
+// of this many entries (22 bytes each), shared by all panels; 0 turns it
+// off and leaves scaled text to Adafruit_GFX
+#ifndef SSD1306_GLYPH_CACHE
+#define SSD1306_GLYPH_CACHE 8
+#endif
+
+// Message bus id and events used by the displayAsync() flush fibers and
+// the bus scheduler
+#define SSD1306_ID                  9306
+#define SSD1306_EVT_FLUSH           1
+#define SSD1306_EVT_FLUSH_DONE      2
+#define SSD1306_EVT_BUS             3
+
 #define SSD1306_SETCONTRAST         0x81
 #define SSD1306_DISPLAYALLON_RESUME 0xA4
 #define SSD1306_DISPLAYALLON        0xA5
@@ -69,35 +105,244 @@ All text above, and the splash screen must be included in any redistribution
 #define SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL 0x29
 #define SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL 0x2A
 
-class Adafruit_SSD1306 : public Adafruit_GFX {
+// Length of the command sequence init() sends after reset
+#define SSD1306_INIT_LEN 26
+
+uint8_t ssd1306_initSequence(char *out, uint8_t rows, uint8_t compins);
+
+// Shares the bus fairly between panels.  Each flush takes a ticket before
+// it starts and after every page the background flush sends, so when
+// several panels are flushing at once their pages go out in turn instead
+// of one panel holding the bus for a whole frame.
+class SSD1306_Bus {
  public:
-    Adafruit_SSD1306(MicroBit& micro);
+  static void acquire(void);
+  static void release(void);
+  static void yield(void);
+  static uint16_t waiting(void);
+
+ private:
+  static uint16_t nextTicket;
+  static uint16_t serving;
+};
+
+// The driver for one panel geometry.  Width, height, COM pin config and
+// the first GDDRAM column the glass is wired to are compile time constants,
+// so the buffer is exactly as big as the panel and every loop bound is
+// known to the compiler.  The member functions live in Adafruit_SSD1306.cpp
+// and are explicitly instantiated there for the geometries typedef'd below;
+// add a line there to support another one.
+template <class Target> class SSD1306_Render;
+
+template <int16_t W, int16_t H, uint8_t COMPINS, uint8_t COLOFFSET = (128 - W) / 2>
+class Adafruit_SSD1306_Panel : public Adafruit_GFX {
+ public:
+    static const uint8_t PAGES = H / 8;
+    static const uint16_t BUFSIZE = W * H / 8;
+
+    // Bytes of caller supplied storage a panel needs: the buffer plus a
+    // word of headroom for the control byte in front of it
+    static const uint16_t FRAMESIZE = BUFSIZE + 4;
+
+    // storage, if given, must be word aligned and FRAMESIZE bytes long;
+    // otherwise the buffer is allocated on the heap.  If that fails, init()
+    // returns false and the panel must not be drawn on; display(),
+    // displayRegion(), displayPages() and displayAsync() then do nothing.
+    Adafruit_SSD1306_Panel(SSD1306_Transport &transport, uint8_t *storage = NULL);
+#ifndef SSD1306_HOST
+    Adafruit_SSD1306_Panel(MicroBit& micro, uint8_t address = SSD1306_I2C_ADDRESS, uint8_t *storage = NULL);
+#endif
     
-    void init();
+    bool init();
     void ssd1306_command(uint8_t c);
+    void beginCommands(void);
+    void appendCommand(uint8_t c);
+    void commitCommands(void);
     void display();
+    void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h);
+    void displayPages(uint8_t first, uint8_t last);
+    void displayAsync();
+    bool isFlushing(void);
+    void waitForFlush(void);
+    bool setDiffMode(bool enable);
+    void invalidate(void);
+    void setMaxChunk(uint16_t bytes);
+    uint8_t *getBuffer(void);
     void drawPixel(int16_t x, int16_t y, uint16_t color);
+    virtual void setRotation(uint8_t r);
+
+    // Console mode, for 64 row panels: panel RAM becomes a ring of pages
+    // and a new line scrolls by moving the display start line, so a line
+    // of text costs one page of bus traffic instead of a frame.  Only text
+    // written through write()/print() lands where it shows up; other
+    // drawing uses raw ring coordinates.
+    bool setConsole(bool enable);
+    virtual uint8_t write(uint8_t c);
+    using Adafruit_GFX::write;
     
     void clearDisplay(void);
   void invertDisplay(uint8_t i);
 
-  void startscrollright(uint8_t start, uint8_t stop);
-  void startscrollleft(uint8_t start, uint8_t stop);
+  // interval is the SSD1306 frames-per-step setting, 0 (5 frames) to 7
+  void startscrollright(uint8_t start, uint8_t stop, uint8_t interval = 0);
+  void startscrollleft(uint8_t start, uint8_t stop, uint8_t interval = 0);
 
-  void startscrolldiagright(uint8_t start, uint8_t stop);
-  void startscrolldiagleft(uint8_t start, uint8_t stop);
-  void stopscroll(void);
+  void startscrolldiagright(uint8_t start, uint8_t stop, uint8_t interval = 0);
+  void startscrolldiagleft(uint8_t start, uint8_t stop, uint8_t interval = 0);
+  void stopscroll(bool follow = false);
+  uint32_t scrollSteps(void);
+  void setFramePeriod(uint32_t us);
 
   void dim(bool dim);
 
   virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
   virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  // Unrotated text is copied into the buffer a font column at a time
+  virtual void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                        uint16_t bg, uint8_t size);
+
+  // The rest of the Adafruit_GFX primitives, run by SSD1306_Render with
+  // this panel's pixel and span writes inlined
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  virtual void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  virtual void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  virtual void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                            int16_t x2, int16_t y2, uint16_t color);
+  virtual void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                            int16_t x2, int16_t y2, uint16_t color);
+  virtual void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                             int16_t r, uint16_t color);
+  virtual void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                             int16_t r, uint16_t color);
+  virtual void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                          int16_t w, int16_t h, uint16_t color);
+  virtual void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                          int16_t w, int16_t h, uint16_t color, uint16_t bg);
     
     private:
-    MicroBit &micro;
-     inline void drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color) __attribute__((always_inline));
-  inline void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color) __attribute__((always_inline)); 
+    // Per-page dirty column range, [min, max] inclusive.  A page is clean
+    // when min > max.  display() only sends the dirty spans.
+    struct DirtyMap {
+      uint8_t min[PAGES];
+      uint8_t max[PAGES];
+    };
+
+    // 'buffer' is what the drawing functions write to.  Every frame is
+    // word aligned and has a spare word in front, so the whole buffer can
+    // go out in one write with no copy; the transport borrows the byte in
+    // front of a span for its control byte.  With displayAsync() buffer
+    // alternates with a second heap allocated frame; 'sending' is whichever
+    // one the flush fiber is currently streaming to the panel.
+    char *buffer;
+    char *spare;
+    char *sending;
+
+    DirtyMap dirty;      // buffer vs. panel
+    DirtyMap sendDirty;  // sending vs. panel, owned by the flush fiber
+
+    bool flushing;
+#ifndef SSD1306_HOST
+    bool flushFiberStarted;
+#endif
+
+    // Copy of what the panel last received, for setDiffMode().  Bit n of
+    // shadowValid is set once page n of the shadow matches the panel.
+    char *shadow;
+    uint8_t shadowValid;
+
+    // Display start line wanted for buffer / for sending, and the one the
+    // panel has now
+    uint8_t startLine;
+    uint8_t sendStartLine;
+    uint8_t panelStartLine;
+
+    // Console state: the ring page shown at the top, and a newline held
+    // back until there is text for the new line
+    bool console;
+    uint8_t consoleTop;
+    bool consoleNewline;
+    void consoleLineFeed(void);
+
+    // Hardware scroll in progress: pages, interval setting, direction
+    // (0 when not scrolling) and when it started
+    uint8_t scrollFirst, scrollLast, scrollInterval;
+    int8_t scrollDir;
+    uint32_t scrollStart;
+    uint32_t framePeriod;
+    void beginScroll(uint8_t start, uint8_t stop, uint8_t interval, int8_t dir);
+    inline bool isScrolling(uint8_t page);
+
+    SSD1306_Transport &transport;
+    char cmdBuf[SSD1306_CMD_BATCH_MAX + 1]; // [0] is the control byte
+    uint8_t cmdLen;
+    uint8_t batchDepth;
+    void flushCommands(void);
+    uint16_t maxChunk;
+    void sendData(char *data, uint16_t len, bool yield);
+    void flushWindow(uint8_t x0, uint8_t x1, uint8_t first, uint8_t last);
+    void displayWindow(char *frame, uint8_t x0, uint8_t x1, uint8_t first, uint8_t last, bool yield);
+    void displayPageDiff(char *frame, uint8_t page, uint8_t x0, uint8_t x1, bool yield);
+    void flush(char *frame, DirtyMap &d, uint8_t line, bool yield);
+#ifndef SSD1306_HOST
+    static void flushFiber(void *param);
+#endif
+    void setup(uint8_t *storage);
+    inline void markDirty(uint8_t page, uint8_t x0, uint8_t x1) __attribute__((always_inline));
+    inline void markDirtyPages(uint8_t first, uint8_t last, uint8_t x0, uint8_t x1);
+    static inline void markClean(DirtyMap &d, uint8_t page);
+    static inline bool isDirty(const DirtyMap &d, uint8_t page);
+    // Buffer writes in panel coordinates, clipped
+    inline void rawPixel(int16_t x, int16_t y, uint16_t color) __attribute__((always_inline));
+    void drawFastVLineInternal(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void drawFastHLineInternal(int16_t x, int16_t y, int16_t w, uint16_t color);
+    // The same without the clipping or dirty marking
+    inline void fillRow(int16_t x, int16_t y, int16_t w, uint16_t color) __attribute__((always_inline));
+    void fillColumn(int16_t x, int16_t y, int16_t h, uint16_t color);
+    void fillBox(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void drawScaledGlyph(int16_t x, int16_t y, const uint8_t *columns, uint16_t color,
+                         uint16_t bg, uint8_t size);
+
+    // The panel at a fixed rotation R, as an SSD1306_Render target.  The
+    // mapping from logical to panel coordinates is resolved at compile
+    // time, so drawing through a view has no per pixel rotation switch;
+    // each primitive picks the view for the current rotation once.  R of
+    // 4 reads the rotation per call, for primitives made of a few spans
+    // where four copies would cost more flash than they save time.
+    template <uint8_t R> struct View {
+      Adafruit_SSD1306_Panel &panel;
+      View(Adafruit_SSD1306_Panel &panel) : panel(panel) {}
+      int16_t width(void) const { return panel.width(); }
+      int16_t height(void) const { return panel.height(); }
+      inline void plot(int16_t x, int16_t y, uint16_t color);
+      inline void hspan(int16_t x, int16_t y, int16_t w, uint16_t color);
+      inline void vspan(int16_t x, int16_t y, int16_t h, uint16_t color);
+      inline void hrun(int16_t x, int16_t y, int16_t w, uint16_t color);
+      inline void vrun(int16_t x, int16_t y, int16_t h, uint16_t color);
+      inline void mark(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+      inline void fill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    };
+
+    // drawPixel(), drawFastHLine() and drawFastVLine() through the view for
+    // each rotation; setRotation() points 'rotated' at the one to use, so
+    // those calls don't look at the rotation at all
+    template <uint8_t R> void plotAt(int16_t x, int16_t y, uint16_t color);
+    template <uint8_t R> void hspanAt(int16_t x, int16_t y, int16_t w, uint16_t color);
+    template <uint8_t R> void vspanAt(int16_t x, int16_t y, int16_t h, uint16_t color);
+    struct Spans {
+      void (Adafruit_SSD1306_Panel::*plot)(int16_t x, int16_t y, uint16_t color);
+      void (Adafruit_SSD1306_Panel::*hspan)(int16_t x, int16_t y, int16_t w, uint16_t color);
+      void (Adafruit_SSD1306_Panel::*vspan)(int16_t x, int16_t y, int16_t h, uint16_t color);
+    };
+    static const Spans spans[4];
+    const Spans *rotated;
     
 };
 
+typedef Adafruit_SSD1306_Panel<128, 64, SSD1306_COMPINS_ALT> Adafruit_SSD1306;
+typedef Adafruit_SSD1306_Panel<128, 32, SSD1306_COMPINS_SEQ> Adafruit_SSD1306_128x32;
+typedef Adafruit_SSD1306_Panel<64, 48, SSD1306_COMPINS_ALT>  Adafruit_SSD1306_64x48;
+
 #endif /* _Adafruit_SSD1306_H_ */
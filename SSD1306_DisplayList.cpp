@@ -0,0 +1,425 @@
+/*********************************************************************
+Display lists for Adafruit_GFX
+*********************************************************************/
+
+#include "SSD1306_DisplayList.h"
+
+enum {
+  DL_PIXEL,
+  DL_HLINE,
+  DL_VLINE,
+  DL_LINE,
+  DL_RECT,
+  DL_FILLRECT,
+  DL_FILLSCREEN,
+  DL_CIRCLE,
+  DL_FILLCIRCLE,
+  DL_TRIANGLE,
+  DL_FILLTRIANGLE,
+  DL_ROUNDRECT,
+  DL_FILLROUNDRECT,
+  DL_BITMAP,
+  DL_BITMAP_BG,
+  DL_TEXT
+};
+
+// Bytes of bounding box in front of every command's arguments
+#define DL_BOX 8
+
+static inline int16_t min16(int16_t a, int16_t b) { return a < b ? a : b; }
+static inline int16_t max16(int16_t a, int16_t b) { return a > b ? a : b; }
+
+// Columns (or rows) a rectangle at v of size s, with corners of radius r,
+// can draw on: not only v to v + s - 1, since the sides are still drawn
+// at v and v + s - 1 when s is 0 or less, and corners wider than the
+// rectangle reach past it
+static void extent(int32_t v, int32_t s, int32_t r, int16_t &lo, int16_t &hi) {
+  int32_t ends[6] = { v, v + s - 1, v + r, v + s - r - 1, v + s - 2 * r - 1, v + 2 * r };
+  int32_t a = ends[0], b = ends[0];
+  for (uint8_t i = 1; i < 6; i++) {
+    if (ends[i] < a) a = ends[i];
+    if (ends[i] > b) b = ends[i];
+  }
+  lo = (a < -0x8000) ? -0x8000 : a;
+  hi = (b > 0x7FFF) ? 0x7FFF : b;
+}
+
+SSD1306_DisplayList::SSD1306_DisplayList(uint8_t *storage, uint16_t capacity) :
+  storage(storage), capacity(capacity) {
+  clear();
+}
+
+void SSD1306_DisplayList::clear(void) {
+  used = 0;
+  overflow = false;
+  dirty = false;
+}
+
+// Start a command with bytes of arguments, if there is room for it.  The
+// bounding box x0, y0 - x1, y1 (inclusive) goes in front of the arguments.
+bool SSD1306_DisplayList::begin(uint8_t op, uint16_t bytes,
+                                int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+  if ((uint32_t) used + 1 + DL_BOX + bytes > capacity) {
+    overflow = true;
+    return false;
+  }
+  put8(op);
+  put16(x0); put16(y0); put16(x1); put16(y1);
+  return true;
+}
+
+void SSD1306_DisplayList::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (!begin(DL_PIXEL, 5, x, y, x, y)) return;
+  put16(x); put16(y); put8(color);
+}
+
+void SSD1306_DisplayList::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  int16_t x0, x1;
+  extent(x, w, 0, x0, x1);
+  if (!begin(DL_HLINE, 7, x0, y, x1, y)) return;
+  put16(x); put16(y); put16(w); put8(color);
+}
+
+void SSD1306_DisplayList::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  int16_t y0, y1;
+  extent(y, h, 0, y0, y1);
+  if (!begin(DL_VLINE, 7, x, y0, x, y1)) return;
+  put16(x); put16(y); put16(h); put8(color);
+}
+
+void SSD1306_DisplayList::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  if (!begin(DL_LINE, 9, min16(x0, x1), min16(y0, y1), max16(x0, x1), max16(y0, y1))) return;
+  put16(x0); put16(y0); put16(x1); put16(y1); put8(color);
+}
+
+void SSD1306_DisplayList::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  int16_t x0, y0, x1, y1;
+  extent(x, w, 0, x0, x1);
+  extent(y, h, 0, y0, y1);
+  if (!begin(DL_RECT, 9, x0, y0, x1, y1)) return;
+  put16(x); put16(y); put16(w); put16(h); put8(color);
+}
+
+void SSD1306_DisplayList::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  int16_t x0, y0, x1, y1;
+  extent(x, w, 0, x0, x1);
+  extent(y, h, 0, y0, y1);
+  if (!begin(DL_FILLRECT, 9, x0, y0, x1, y1)) return;
+  put16(x); put16(y); put16(w); put16(h); put8(color);
+}
+
+void SSD1306_DisplayList::fillScreen(uint16_t color) {
+  if (!begin(DL_FILLSCREEN, 1, -0x8000, -0x8000, 0x7FFF, 0x7FFF)) return;
+  put8(color);
+}
+
+void SSD1306_DisplayList::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  int16_t xa, xb, ya, yb;
+  extent(x0 - r, 2 * r + 1, 0, xa, xb);
+  extent(y0 - r, 2 * r + 1, 0, ya, yb);
+  if (!begin(DL_CIRCLE, 7, xa, ya, xb, yb)) return;
+  put16(x0); put16(y0); put16(r); put8(color);
+}
+
+void SSD1306_DisplayList::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color) {
+  int16_t xa, xb, ya, yb;
+  extent(x0 - r, 2 * r + 1, 0, xa, xb);
+  extent(y0 - r, 2 * r + 1, 0, ya, yb);
+  if (!begin(DL_FILLCIRCLE, 7, xa, ya, xb, yb)) return;
+  put16(x0); put16(y0); put16(r); put8(color);
+}
+
+void SSD1306_DisplayList::drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                       int16_t x2, int16_t y2, uint16_t color) {
+  if (!begin(DL_TRIANGLE, 13, min16(x0, min16(x1, x2)), min16(y0, min16(y1, y2)),
+             max16(x0, max16(x1, x2)), max16(y0, max16(y1, y2)))) return;
+  put16(x0); put16(y0); put16(x1); put16(y1); put16(x2); put16(y2); put8(color);
+}
+
+void SSD1306_DisplayList::fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                       int16_t x2, int16_t y2, uint16_t color) {
+  if (!begin(DL_FILLTRIANGLE, 13, min16(x0, min16(x1, x2)), min16(y0, min16(y1, y2)),
+             max16(x0, max16(x1, x2)), max16(y0, max16(y1, y2)))) return;
+  put16(x0); put16(y0); put16(x1); put16(y1); put16(x2); put16(y2); put8(color);
+}
+
+void SSD1306_DisplayList::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                        int16_t r, uint16_t color) {
+  int16_t x0, y0, x1, y1;
+  extent(x, w, r, x0, x1);
+  extent(y, h, r, y0, y1);
+  if (!begin(DL_ROUNDRECT, 11, x0, y0, x1, y1)) return;
+  put16(x); put16(y); put16(w); put16(h); put16(r); put8(color);
+}
+
+void SSD1306_DisplayList::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                        int16_t r, uint16_t color) {
+  int16_t x0, y0, x1, y1;
+  extent(x, w, r, x0, x1);
+  extent(y, h, r, y0, y1);
+  if (!begin(DL_FILLROUNDRECT, 11, x0, y0, x1, y1)) return;
+  put16(x); put16(y); put16(w); put16(h); put16(r); put8(color);
+}
+
+void SSD1306_DisplayList::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                                     int16_t w, int16_t h, uint16_t color) {
+  if (!begin(DL_BITMAP, 9 + sizeof(bitmap), x, y, x + w - 1, y + h - 1)) return;
+  put16(x); put16(y); put16(w); put16(h); put8(color);
+  memcpy(storage + used, &bitmap, sizeof(bitmap));
+  used += sizeof(bitmap);
+}
+
+void SSD1306_DisplayList::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                                     int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  if (!begin(DL_BITMAP_BG, 10 + sizeof(bitmap), x, y, x + w - 1, y + h - 1)) return;
+  put16(x); put16(y); put16(w); put16(h); put8(color); put8(bg);
+  memcpy(storage + used, &bitmap, sizeof(bitmap));
+  used += sizeof(bitmap);
+}
+
+void SSD1306_DisplayList::drawText(int16_t x, int16_t y, const char *text, uint8_t size,
+                                   uint16_t color, uint16_t bg) {
+  size_t len = strlen(text);
+  if (len > 255) len = 255;
+
+  // text is replayed without wrapping, so the box is the longest line by
+  // the number of lines; a newline goes back to column 0
+  int16_t lines = 1, longest = 0, column = 0, left = x;
+  for (size_t i = 0; i < len; i++) {
+    if (text[i] == '\n') {
+      lines++;
+      column = 0;
+      if (left > 0) left = 0;
+    } else if (text[i] != '\r') {
+      column++;
+      if (column > longest) longest = column;
+    }
+  }
+  int16_t right = max16(x, 0) + longest * 6 * size - 1;
+  if (!begin(DL_TEXT, 8 + len, left, y, right, y + lines * 8 * size - 1)) return;
+  put16(x); put16(y); put8(size); put8(color); put8(bg); put8(len);
+  memcpy(storage + used, text, len);
+  used += len;
+}
+
+// Argument readers for replay()
+static inline int16_t get16(const uint8_t *&p) {
+  int16_t v = p[0] | (p[1] << 8);
+  p += 2;
+  return v;
+}
+
+static inline uint8_t get8(const uint8_t *&p) {
+  return *p++;
+}
+
+// Bytes of arguments after the box, by opcode; text adds its length
+static const uint8_t argBytes[] = {
+  5, 7, 7, 9, 9, 9, 1, 7, 7, 13, 13, 11, 11,
+  9 + sizeof(const uint8_t *), 10 + sizeof(const uint8_t *), 8
+};
+
+void SSD1306_DisplayList::replay(Adafruit_GFX &gfx) const {
+  replayBox(gfx, -0x8000, -0x8000, 0x7FFF, 0x7FFF);
+}
+
+void SSD1306_DisplayList::replay(Adafruit_GFX &gfx, int16_t x, int16_t y,
+                                 int16_t w, int16_t h) const {
+  replayBox(gfx, x, y, x + w - 1, y + h - 1);
+}
+
+// Replay the commands whose box meets x0, y0 - x1, y1 (inclusive)
+void SSD1306_DisplayList::replayBox(Adafruit_GFX &gfx, int16_t x0, int16_t y0,
+                                    int16_t x1, int16_t y1) const {
+  const uint8_t *p = storage;
+  const uint8_t *end = storage + used;
+
+  while (p < end) {
+    uint8_t op = get8(p);
+    if (op > DL_TEXT) {
+      // not something we wrote; stop rather than misread the rest
+      return;
+    }
+    int16_t bx0 = get16(p), by0 = get16(p), bx1 = get16(p), by1 = get16(p);
+    if (bx1 < x0 || bx0 > x1 || by1 < y0 || by0 > y1) {
+      p += argBytes[op] + ((op == DL_TEXT) ? p[7] : 0);
+      continue;
+    }
+    int16_t a, b, c, d, e, f;
+    uint8_t color;
+
+    switch (op) {
+    case DL_PIXEL:
+      a = get16(p); b = get16(p);
+      gfx.drawPixel(a, b, get8(p));
+      break;
+    case DL_HLINE:
+      a = get16(p); b = get16(p); c = get16(p);
+      gfx.drawFastHLine(a, b, c, get8(p));
+      break;
+    case DL_VLINE:
+      a = get16(p); b = get16(p); c = get16(p);
+      gfx.drawFastVLine(a, b, c, get8(p));
+      break;
+    case DL_LINE:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p);
+      gfx.drawLine(a, b, c, d, get8(p));
+      break;
+    case DL_RECT:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p);
+      gfx.drawRect(a, b, c, d, get8(p));
+      break;
+    case DL_FILLRECT:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p);
+      gfx.fillRect(a, b, c, d, get8(p));
+      break;
+    case DL_FILLSCREEN:
+      gfx.fillScreen(get8(p));
+      break;
+    case DL_CIRCLE:
+      a = get16(p); b = get16(p); c = get16(p);
+      gfx.drawCircle(a, b, c, get8(p));
+      break;
+    case DL_FILLCIRCLE:
+      a = get16(p); b = get16(p); c = get16(p);
+      gfx.fillCircle(a, b, c, get8(p));
+      break;
+    case DL_TRIANGLE:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p); e = get16(p); f = get16(p);
+      gfx.drawTriangle(a, b, c, d, e, f, get8(p));
+      break;
+    case DL_FILLTRIANGLE:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p); e = get16(p); f = get16(p);
+      gfx.fillTriangle(a, b, c, d, e, f, get8(p));
+      break;
+    case DL_ROUNDRECT:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p); e = get16(p);
+      gfx.drawRoundRect(a, b, c, d, e, get8(p));
+      break;
+    case DL_FILLROUNDRECT:
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p); e = get16(p);
+      gfx.fillRoundRect(a, b, c, d, e, get8(p));
+      break;
+    case DL_BITMAP:
+    case DL_BITMAP_BG: {
+      a = get16(p); b = get16(p); c = get16(p); d = get16(p);
+      color = get8(p);
+      uint8_t bg = (op == DL_BITMAP_BG) ? get8(p) : color;
+      const uint8_t *bitmap;
+      memcpy(&bitmap, p, sizeof(bitmap));
+      p += sizeof(bitmap);
+      if (op == DL_BITMAP_BG) {
+        gfx.drawBitmap(a, b, bitmap, c, d, color, bg);
+      } else {
+        gfx.drawBitmap(a, b, bitmap, c, d, color);
+      }
+      break;
+    }
+    case DL_TEXT: {
+      a = get16(p); b = get16(p);
+      uint8_t size = get8(p);
+      color = get8(p);
+      uint8_t bg = get8(p);
+      uint8_t len = get8(p);
+
+      // write() goes through the target's text settings: save them first
+      int16_t cursorX = gfx.getCursorX(), cursorY = gfx.getCursorY();
+      uint8_t oldSize = gfx.getTextSize();
+      uint16_t oldColor = gfx.getTextColor(), oldBg = gfx.getTextBackground();
+      bool oldWrap = gfx.getTextWrap();
+
+      gfx.setCursor(a, b);
+      gfx.setTextSize(size);
+      gfx.setTextColor(color, bg);
+      gfx.setTextWrap(false);
+      gfx.write(p, len);
+      p += len;
+
+      gfx.setCursor(cursorX, cursorY);
+      gfx.setTextSize(oldSize);
+      gfx.setTextColor(oldColor, oldBg);
+      gfx.setTextWrap(oldWrap);
+      break;
+    }
+    }
+  }
+}
+
+// Forwards drawing to a target, dropping everything outside a rectangle.
+// Only the primitives everything else is built from need clipping.
+class SSD1306_ClipGFX : public Adafruit_GFX {
+ public:
+  SSD1306_ClipGFX(Adafruit_GFX &target, int16_t x0, int16_t y0, int16_t x1, int16_t y1) :
+    Adafruit_GFX(target.width(), target.height()), target(target),
+    x0(x0), y0(y0), x1(x1), y1(y1) {
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x < x0 || x > x1 || y < y0 || y > y1) return;
+    target.drawPixel(x, y, color);
+  }
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x, y, w, 1, color);
+  }
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x, y, 1, h, color);
+  }
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    int16_t l = max16(x, x0), r = min16(x + w - 1, x1);
+    int16_t t = max16(y, y0), b = min16(y + h - 1, y1);
+    if (l > r || t > b) return;
+    if (l == r) {
+      target.drawFastVLine(l, t, b - t + 1, color);
+    } else if (t == b) {
+      target.drawFastHLine(l, t, r - l + 1, color);
+    } else {
+      target.fillRect(l, t, r - l + 1, b - t + 1, color);
+    }
+  }
+
+ private:
+  Adafruit_GFX &target;
+  int16_t x0, y0, x1, y1;
+};
+
+void SSD1306_DisplayList::invalidate(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (w <= 0 || h <= 0) return;
+  if (!dirty) {
+    dirtyX0 = x; dirtyY0 = y;
+    dirtyX1 = x + w - 1; dirtyY1 = y + h - 1;
+    dirty = true;
+    return;
+  }
+  dirtyX0 = min16(dirtyX0, x); dirtyY0 = min16(dirtyY0, y);
+  dirtyX1 = max16(dirtyX1, x + w - 1); dirtyY1 = max16(dirtyY1, y + h - 1);
+}
+
+bool SSD1306_DisplayList::invalidRect(int16_t &x, int16_t &y, int16_t &w, int16_t &h) const {
+  if (!dirty) return false;
+  x = dirtyX0; y = dirtyY0;
+  w = dirtyX1 - dirtyX0 + 1; h = dirtyY1 - dirtyY0 + 1;
+  return true;
+}
+
+bool SSD1306_DisplayList::redraw(Adafruit_GFX &gfx, uint16_t bg) {
+  if (!dirty) return false;
+  dirty = false;
+  redraw(gfx, dirtyX0, dirtyY0, dirtyX1 - dirtyX0 + 1, dirtyY1 - dirtyY0 + 1, bg);
+  return true;
+}
+
+void SSD1306_DisplayList::redraw(Adafruit_GFX &gfx, int16_t x, int16_t y,
+                                 int16_t w, int16_t h, uint16_t bg) {
+  // keep to the screen so the clip box can't overflow
+  int16_t x0 = max16(x, 0), y0 = max16(y, 0);
+  int16_t x1 = min16(x + w - 1, gfx.width() - 1);
+  int16_t y1 = min16(y + h - 1, gfx.height() - 1);
+  if (x0 > x1 || y0 > y1) return;
+
+  SSD1306_ClipGFX clip(gfx, x0, y0, x1, y1);
+  clip.fillRect(x0, y0, x1 - x0 + 1, y1 - y0 + 1, bg);
+  replayBox(clip, x0, y0, x1, y1);
+}
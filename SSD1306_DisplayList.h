@@ -0,0 +1,99 @@
+/*********************************************************************
+Display lists for Adafruit_GFX
+
+A display list records drawing calls into a compact byte buffer so they
+can be replayed later onto any Adafruit_GFX target.  Adafruit_SSD1306_Strip
+uses this to render a frame a page at a time, replaying the list once per
+page, so no full framebuffer is needed.
+
+Each command is an opcode byte, the command's bounding box, then its
+arguments: coordinates and sizes as 16 bit little endian values, colors
+and text sizes as single bytes.  Text is stored inline; bitmaps are stored
+by pointer, so they must outlive the list (const data in flash usually
+does).
+
+The list is retained: it can be kept as the description of the screen and
+replayed again after part of it changes.  invalidate() marks a rectangle
+as stale and redraw() repaints just that rectangle, clearing it and
+replaying only the commands whose box meets it, clipped to it.  The
+rectangle can then be sent with displayRegion() instead of a full frame.
+*********************************************************************/
+
+#ifndef _SSD1306_DisplayList_H_
+#define _SSD1306_DisplayList_H_
+
+#include "Adafruit_GFX.h"
+
+class SSD1306_DisplayList {
+ public:
+  // Records into caller supplied storage.  A command that doesn't fit is
+  // dropped and sets overflowed().
+  SSD1306_DisplayList(uint8_t *storage, uint16_t capacity);
+
+  void clear(void);
+  uint16_t length(void) const { return used; }
+  bool overflowed(void) const { return overflow; }
+
+  // Draw everything recorded, in order, onto target.  The target's text
+  // cursor and settings are left as they were.
+  void replay(Adafruit_GFX &target) const;
+  // Draw only the commands whose bounding box meets the rectangle.  They
+  // are drawn whole; nothing is clipped to the rectangle.
+  void replay(Adafruit_GFX &target, int16_t x, int16_t y, int16_t w, int16_t h) const;
+
+  // Mark a rectangle of the screen as needing a redraw.  Rectangles
+  // accumulate into one covering rectangle until redraw().
+  void invalidate(int16_t x, int16_t y, int16_t w, int16_t h);
+  // The rectangle redraw() would repaint; false if nothing is invalid
+  bool invalidRect(int16_t &x, int16_t &y, int16_t &w, int16_t &h) const;
+  // Repaint the invalid rectangle on target; false if there was none
+  bool redraw(Adafruit_GFX &target, uint16_t bg = 0);
+  // Fill the rectangle with bg and replay the commands that meet it,
+  // drawing nothing outside it
+  void redraw(Adafruit_GFX &target, int16_t x, int16_t y, int16_t w, int16_t h,
+              uint16_t bg = 0);
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void fillScreen(uint16_t color);
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void drawTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                    int16_t x2, int16_t y2, uint16_t color);
+  void fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                    int16_t x2, int16_t y2, uint16_t color);
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                     int16_t r, uint16_t color);
+  void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                     int16_t r, uint16_t color);
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                  int16_t w, int16_t h, uint16_t color);
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap,
+                  int16_t w, int16_t h, uint16_t color, uint16_t bg);
+
+  // Text at x, y as print() would draw it with the given size and colors
+  // (bg == color for transparent), without wrapping.  Up to 255
+  // characters.
+  void drawText(int16_t x, int16_t y, const char *text, uint8_t size,
+                uint16_t color, uint16_t bg);
+
+ private:
+  uint8_t *storage;
+  uint16_t capacity, used;
+  bool overflow;
+
+  // Invalid rectangle, inclusive
+  bool dirty;
+  int16_t dirtyX0, dirtyY0, dirtyX1, dirtyY1;
+
+  bool begin(uint8_t op, uint16_t bytes, int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+  void replayBox(Adafruit_GFX &target, int16_t x0, int16_t y0, int16_t x1, int16_t y1) const;
+  void put8(uint8_t v) { storage[used++] = v; }
+  void put16(int16_t v) { storage[used++] = v & 0xFF; storage[used++] = (uint16_t) v >> 8; }
+};
+
+#endif /* _SSD1306_DisplayList_H_ */
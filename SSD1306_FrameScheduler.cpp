@@ -0,0 +1,100 @@
+/*********************************************************************
+Frame pacing for SSD1306 animations
+*********************************************************************/
+
+#include "SSD1306_FrameScheduler.h"
+
+#ifdef SSD1306_HOST
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(uint32_t us)
+{
+  usleep(us);
+}
+#else
+#include "pxt.h"
+
+static uint64_t now_us(void)
+{
+  return system_timer_current_time_us();
+}
+
+// Fibers sleep in whole milliseconds; the deadlines are absolute, so the
+// rounding doesn't build up from frame to frame
+static void sleep_us(uint32_t us)
+{
+  if (us >= 1000) {
+    fiber_sleep(us / 1000);
+  } else {
+    schedule();
+  }
+}
+#endif
+
+void SSD1306_FrameScheduler::setFPS(uint16_t fps)
+{
+  period = 1000000 / (fps ? fps : 1);
+}
+
+void SSD1306_FrameScheduler::resetStats(void)
+{
+  frames = dropped = overBudget = 0;
+  minTime = 0xFFFFFFFF;
+  maxTime = 0;
+  totalTime = 0;
+  frame = 0;
+}
+
+void SSD1306_FrameScheduler::stop(void)
+{
+  running = false;
+}
+
+void SSD1306_FrameScheduler::run(uint32_t count)
+{
+  uint64_t next = now_us();
+  uint32_t done = 0;
+
+  running = true;
+  while (running && (count == 0 || done < count)) {
+    uint64_t start = now_us();
+    draw(context, frame);
+    flushFn(panel);
+    uint64_t end = now_us();
+
+    uint32_t t = end - start;
+    if (t < minTime) minTime = t;
+    if (t > maxTime) maxTime = t;
+    if (t > period) overBudget++;
+    totalTime += t;
+    frames++;
+
+    frame++;
+    done++;
+    next += period;
+
+    if (end >= next + period) {
+      // whole frame slots have gone by: drop them and pick up at the
+      // current one
+      uint32_t skip = (end - next) / period;
+      if (count && skip > count - done) skip = count - done;
+      frame += skip;
+      done += skip;
+      dropped += skip;
+      next += (uint64_t) skip * period;
+    }
+
+    if (next > end && (count == 0 || done < count)) {
+      sleep_us(next - end);
+    }
+  }
+  running = false;
+}
@@ -0,0 +1,71 @@
+/*********************************************************************
+Frame pacing for SSD1306 animations
+
+Calls a draw function and flushes the panel at a steady target rate.
+The time spent drawing and flushing comes out of the sleep before the
+next frame, so the rate doesn't depend on how busy a frame was.  When a
+frame runs over, the frames it ate into are dropped rather than drawn
+late: the next draw gets a frame number that has moved on by as many, so
+animations keyed to it stay on time.
+*********************************************************************/
+
+#ifndef _SSD1306_FrameScheduler_H_
+#define _SSD1306_FrameScheduler_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class SSD1306_FrameScheduler {
+ public:
+  // Draw frame number 'frame' into the panel's buffer
+  typedef void (*DrawFn)(void *context, uint32_t frame);
+
+  // Works with any panel type that has display() and displayAsync().  With
+  // async set, frames go out with displayAsync() and the next one is drawn
+  // while the last is still on the bus.
+  template <class Panel>
+  SSD1306_FrameScheduler(Panel &panel, uint16_t fps, DrawFn draw,
+                         void *context = NULL, bool async = false) :
+    panel(&panel), flushFn(async ? &flushAsync<Panel> : &flushSync<Panel>),
+    draw(draw), context(context) {
+    setFPS(fps);
+    resetStats();
+  }
+
+  void setFPS(uint16_t fps);
+
+  // Run count frames, or until stop() if count is 0.  Frames dropped
+  // because the previous one ran late count towards count.
+  void run(uint32_t count = 0);
+  void stop(void);
+
+  void resetStats(void);
+
+  // Draw + flush time per frame, in microseconds, since resetStats()
+  uint32_t minFrameTime(void) const { return frames ? minTime : 0; }
+  uint32_t maxFrameTime(void) const { return maxTime; }
+  uint32_t avgFrameTime(void) const { return frames ? totalTime / frames : 0; }
+
+  uint32_t
+    frames,       // frames drawn
+    dropped,      // frames skipped because drawing fell behind
+    overBudget;   // frames whose draw + flush took longer than a period
+
+ private:
+  void *panel;
+  void (*flushFn)(void *panel);
+  DrawFn draw;
+  void *context;
+  uint32_t period;    // microseconds
+  uint32_t frame;     // number of the next frame to draw
+  bool running;
+  uint32_t minTime, maxTime;
+  uint64_t totalTime;
+
+  template <class Panel>
+  static void flushSync(void *panel) { ((Panel *) panel)->display(); }
+  template <class Panel>
+  static void flushAsync(void *panel) { ((Panel *) panel)->displayAsync(); }
+};
+
+#endif /* _SSD1306_FrameScheduler_H_ */
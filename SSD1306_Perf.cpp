@@ -0,0 +1,82 @@
+/*********************************************************************
+Optional performance counters for the GFX and SSD1306 drivers
+*********************************************************************/
+
+#include "SSD1306_Perf.h"
+
+#ifdef SSD1306_PERF
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SSD1306_HOST
+#include <time.h>
+#endif
+
+SSD1306_PerfCounters SSD1306_Perf::counters;
+
+static const char *const primitiveNames[SSD1306_PERF_PRIMITIVES] = {
+  "line", "rect", "fillRect", "fillScreen", "circle", "fillCircle",
+  "triangle", "fillTriangle", "roundRect", "fillRoundRect", "bitmap", "char"
+};
+
+void SSD1306_Perf::reset(void)
+{
+  memset(&counters, 0, sizeof(counters));
+}
+
+uint32_t SSD1306_Perf::micros(void)
+{
+#ifdef SSD1306_HOST
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+  return (uint32_t) system_timer_current_time_us();
+#endif
+}
+
+const char *SSD1306_Perf::primitiveName(uint8_t primitive)
+{
+  return primitive < SSD1306_PERF_PRIMITIVES ? primitiveNames[primitive] : "?";
+}
+
+void SSD1306_Perf::dump(void (*write)(const char *line, void *context), void *context)
+{
+  char line[48];
+
+  snprintf(line, sizeof(line), "pixels %lu\r\n", (unsigned long) counters.pixels);
+  write(line, context);
+  snprintf(line, sizeof(line), "spans %lu (%lu px)\r\n",
+           (unsigned long) counters.spans, (unsigned long) counters.spanPixels);
+  write(line, context);
+  for (uint8_t i = 0; i < SSD1306_PERF_PRIMITIVES; i++) {
+    if (counters.calls[i] == 0) continue;
+    snprintf(line, sizeof(line), "%s %lu\r\n", primitiveNames[i], (unsigned long) counters.calls[i]);
+    write(line, context);
+  }
+  snprintf(line, sizeof(line), "transactions %lu\r\n", (unsigned long) counters.transactions);
+  write(line, context);
+  snprintf(line, sizeof(line), "bytes %lu cmd %lu data\r\n",
+           (unsigned long) counters.commandBytes, (unsigned long) counters.dataBytes);
+  write(line, context);
+  snprintf(line, sizeof(line), "flushes %lu, %lu us\r\n",
+           (unsigned long) counters.flushes, (unsigned long) counters.flushUs);
+  write(line, context);
+  snprintf(line, sizeof(line), "commands %lu us\r\n", (unsigned long) counters.commandUs);
+  write(line, context);
+}
+
+#ifndef SSD1306_HOST
+static void serialLine(const char *line, void *context)
+{
+  ((MicroBitSerial *) context)->send(line);
+}
+
+void SSD1306_Perf::dump(MicroBitSerial &serial)
+{
+  dump(serialLine, &serial);
+}
+#endif
+
+#endif /* SSD1306_PERF */
@@ -0,0 +1,96 @@
+/*********************************************************************
+Optional performance counters for the GFX and SSD1306 drivers
+
+Build with SSD1306_PERF defined to count pixels and spans written,
+primitive calls by type, bus transactions and bytes, and the time spent
+flushing and sending commands.  Without it every SSD1306_PERF_* macro
+expands to nothing, so the drawing and flush paths are unchanged.
+
+The two times overlap: flushUs includes the commands each flush sends to
+set its window, and commandUs counts those too.
+
+The counters are global: with several panels they add up across all of
+them.
+*********************************************************************/
+
+#ifndef _SSD1306_Perf_H_
+#define _SSD1306_Perf_H_
+
+#include <stdint.h>
+
+#ifndef SSD1306_HOST
+#include "pxt.h"
+#endif
+
+// Primitive call counters.  Calls a primitive makes to others are counted
+// too: fillRoundRect() also counts a fillRect().
+enum SSD1306_PerfPrimitive {
+  SSD1306_PERF_LINE,
+  SSD1306_PERF_RECT,
+  SSD1306_PERF_FILLRECT,
+  SSD1306_PERF_FILLSCREEN,
+  SSD1306_PERF_CIRCLE,
+  SSD1306_PERF_FILLCIRCLE,
+  SSD1306_PERF_TRIANGLE,
+  SSD1306_PERF_FILLTRIANGLE,
+  SSD1306_PERF_ROUNDRECT,
+  SSD1306_PERF_FILLROUNDRECT,
+  SSD1306_PERF_BITMAP,
+  SSD1306_PERF_CHAR,
+  SSD1306_PERF_PRIMITIVES
+};
+
+#ifdef SSD1306_PERF
+
+struct SSD1306_PerfCounters {
+  uint32_t pixels;          // single pixels written by drawPixel()
+  uint32_t spans;           // horizontal / vertical spans written
+  uint32_t spanPixels;      // pixels covered by those spans
+  uint32_t calls[SSD1306_PERF_PRIMITIVES];
+  uint32_t transactions;    // bus writes, command and data
+  uint32_t commandBytes;
+  uint32_t dataBytes;
+  uint32_t flushes;         // display() and friends, background flushes
+  uint32_t flushUs;         // time spent in them, window commands included
+  uint32_t commandUs;       // time spent sending commands, in flushes too
+};
+
+class SSD1306_Perf {
+ public:
+  static SSD1306_PerfCounters counters;
+
+  static void reset(void);
+  static uint32_t micros(void);
+
+  // Write the counters out as text, a line at a time
+  static void dump(void (*write)(const char *line, void *context), void *context);
+#ifndef SSD1306_HOST
+  static void dump(MicroBitSerial &serial);
+#endif
+
+  static const char *primitiveName(uint8_t primitive);
+};
+
+// Adds the time between construction and the end of the scope to a counter
+class SSD1306_PerfTimer {
+ public:
+  SSD1306_PerfTimer(uint32_t &total) : total(total), start(SSD1306_Perf::micros()) {}
+  ~SSD1306_PerfTimer() { total += SSD1306_Perf::micros() - start; }
+ private:
+  uint32_t &total;
+  uint32_t start;
+};
+
+#define SSD1306_PERF_ADD(counter, n)  (SSD1306_Perf::counters.counter += (n))
+#define SSD1306_PERF_CALL(primitive)  (SSD1306_Perf::counters.calls[primitive]++)
+#define SSD1306_PERF_TIME(counter)    SSD1306_PerfTimer _perfTimer(SSD1306_Perf::counters.counter)
+
+#else
+
+#define SSD1306_PERF_ADD(counter, n)
+#define SSD1306_PERF_CALL(primitive)
+#define SSD1306_PERF_TIME(counter)
+
+#endif /* SSD1306_PERF */
+
+#endif /* _SSD1306_Perf_H_ */
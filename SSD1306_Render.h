@@ -0,0 +1,500 @@
+/*********************************************************************
+Statically dispatched drawing for SSD1306 panels
+
+SSD1306_Render<Target> holds the Adafruit_GFX drawing algorithms written
+against a target type known at compile time, so each pixel and span they
+produce is a direct call the compiler can inline instead of a virtual
+one.  Target provides, in rotated (logical) coordinates:
+
+  plot(x, y, color)       one pixel, clipped
+  hspan(x, y, w, color)   a horizontal run, clipped
+  vspan(x, y, h, color)   a vertical run, clipped
+  hrun(x, y, w, color)    a horizontal run known to be on screen,
+                          written without marking it dirty
+  vrun(x, y, h, color)    the same, vertical
+  mark(x0, y0, x1, y1)    mark an on screen rectangle (inclusive) dirty
+  fill(x, y, w, h, color) a filled rectangle, clipped
+
+plus width() and height().  A panel overrides the virtual Adafruit_GFX
+primitives with one line calls into this, so the Adafruit_GFX interface
+stays as it was and code drawing through an Adafruit_GFX& gets the same
+speed.  The pixels drawn are the same as Adafruit_GFX draws.
+*********************************************************************/
+
+#ifndef _SSD1306_Render_H_
+#define _SSD1306_Render_H_
+
+#include "Adafruit_GFX.h"
+#include "SSD1306_Perf.h"
+#include <stdlib.h>
+
+template <class Target>
+class SSD1306_Render {
+ public:
+  static void line(Target &t, int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  static void rect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  static void fillRect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  static void circle(Target &t, int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  static void fillCircle(Target &t, int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  static void triangle(Target &t, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                       int16_t x2, int16_t y2, uint16_t color);
+  static void fillTriangle(Target &t, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                           int16_t x2, int16_t y2, uint16_t color);
+  static void roundRect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h,
+                        int16_t r, uint16_t color);
+  static void fillRoundRect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h,
+                            int16_t r, uint16_t color);
+  static void bitmap(Target &t, int16_t x, int16_t y, const uint8_t *bitmap,
+                     int16_t w, int16_t h, uint16_t color);
+  static void bitmap(Target &t, int16_t x, int16_t y, const uint8_t *bitmap,
+                     int16_t w, int16_t h, uint16_t color, uint16_t bg);
+  // glyph is the character's 5 font columns
+  static void character(Target &t, int16_t x, int16_t y, const unsigned char *glyph,
+                        uint16_t color, uint16_t bg, uint8_t size);
+
+ private:
+  static void circleHelper(Target &t, int16_t x0, int16_t y0, int16_t r,
+                           uint8_t cornername, uint16_t color);
+  static void fillCircleHelper(Target &t, int16_t x0, int16_t y0, int16_t r,
+                               uint8_t cornername, int16_t delta, uint16_t color);
+
+  // A triangle edge's x on successive scanlines, x0 + dx * k / dy rounded
+  // toward zero as Adafruit_GFX divides it.  The whole part and remainder
+  // of dx / dy are worked out once, so a step is two adds and a compare.
+  struct Edge {
+    int32_t x, whole, carry, rem, dy, acc;
+    void start(int16_t x0, int32_t dx, int32_t dy, int32_t k);
+    void step(void) {
+      x += whole;
+      acc += rem;
+      if (acc >= dy) {
+        acc -= dy;
+        x += carry;
+      }
+    }
+  };
+  static void fillSpan(Target &t, int32_t a, int32_t b, int16_t y, int16_t w, uint16_t color);
+};
+
+// Bresenham's algorithm, drawn a run at a time.  Along the major axis a
+// line is runs of q or q + 1 pixels, q = dx / dy, so each run's length is
+// one comparison and the run is one span written straight into the
+// target, which is marked dirty once for the whole line.  The pixels are
+// the ones Adafruit_GFX::drawLine sets: ends beyond the same edge of the
+// screen are rejected outright, and a line starting off screen begins at
+// the first visible column with the error term Bresenham would have there.
+template <class Target>
+void SSD1306_Render<Target>::line(Target &t, int16_t x0, int16_t y0,
+                                  int16_t x1, int16_t y1, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_LINE);
+  int16_t w = t.width(), h = t.height();
+
+  // outcodes: both ends left, right, above or below
+  if ((x0 < 0 && x1 < 0) || (x0 >= w && x1 >= w) ||
+      (y0 < 0 && y1 < 0) || (y0 >= h && y1 >= h))
+    return;
+
+  bool steep = abs(y1 - y0) > abs(x1 - x0);
+  if (steep) {
+    GFXswap(x0, y0);
+    GFXswap(x1, y1);
+    GFXswap(w, h);
+  }
+
+  if (x0 > x1) {
+    GFXswap(x0, x1);
+    GFXswap(y0, y1);
+  }
+
+  // 32 bits, so ends anywhere in int16 range can't overflow
+  int32_t dx = x1 - x0;
+  int32_t dy = abs(y1 - y0);
+  int32_t ystep = (y0 < y1) ? 1 : -1;
+  int32_t x = x0, y = y0;
+  int32_t err = dx / 2;
+
+  if (x < 0) {
+    // skip -x steps: y moves once for each time the error went negative
+    int32_t e = err + x * dy;
+    if (e < 0) {
+      int32_t steps = (-e - 1) / dx + 1;
+      y += steps * ystep;
+      e += steps * dx;
+    }
+    err = e;
+    x = 0;
+  }
+  if (x1 >= w) x1 = w - 1;
+
+  // The first run's length needs a divide; after it the error is in
+  // [dx - dy, dx), which leaves only q or q + 1.  A flat line is one run.
+  // From here err is kept a run ahead, so choosing the next run is a
+  // compare and an add.
+  int32_t q = dy ? dx / dy : 0;
+  int32_t qdy = q * dy;
+  int32_t run = dy ? err / dy + 1 : x1 - x + 1;
+  err += dx - run * dy;
+
+  // Runs off the top or bottom are stepped over without drawing
+  while ((uint32_t) y >= (uint32_t) h) {
+    if ((ystep > 0) == (y >= h) || run > x1 - x) return;
+    x += run;
+    y += ystep;
+    run = q;
+    if (err >= qdy) {
+      run++;
+      err -= dy;
+    }
+    err += dx - qdy;
+  }
+
+  // Runs until the one cut off at x1, or until the next would be off
+  // the screen
+  int16_t first = x, near = y;
+  while (true) {
+    if (run > x1 - x) {
+      if (steep) t.vrun(y, x, x1 - x + 1, color);
+      else       t.hrun(x, y, x1 - x + 1, color);
+      break;
+    }
+    if (steep) t.vrun(y, x, run, color);
+    else       t.hrun(x, y, run, color);
+    if ((uint32_t) (y + ystep) >= (uint32_t) h) {
+      x1 = x + run - 1;
+      break;
+    }
+
+    x += run;
+    y += ystep;
+    run = q;
+    if (err >= qdy) {
+      run++;
+      err -= dy;
+    }
+    err += dx - qdy;
+  }
+
+  int16_t last = x1, far = y;
+  if (near > far) GFXswap(near, far);
+  if (steep) t.mark(near, first, far, last);
+  else       t.mark(first, near, last, far);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::rect(Target &t, int16_t x, int16_t y,
+                                  int16_t w, int16_t h, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_RECT);
+  t.hspan(x, y, w, color);
+  t.hspan(x, y + h - 1, w, color);
+  t.vspan(x, y, h, color);
+  t.vspan(x + w - 1, y, h, color);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::fillRect(Target &t, int16_t x, int16_t y,
+                                      int16_t w, int16_t h, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLRECT);
+  t.fill(x, y, w, h, color);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::circle(Target &t, int16_t x0, int16_t y0,
+                                    int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_CIRCLE);
+  int16_t f = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x = 0;
+  int16_t y = r;
+
+  t.plot(x0    , y0 + r, color);
+  t.plot(x0    , y0 - r, color);
+  t.plot(x0 + r, y0    , color);
+  t.plot(x0 - r, y0    , color);
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    t.plot(x0 + x, y0 + y, color);
+    t.plot(x0 - x, y0 + y, color);
+    t.plot(x0 + x, y0 - y, color);
+    t.plot(x0 - x, y0 - y, color);
+    t.plot(x0 + y, y0 + x, color);
+    t.plot(x0 - y, y0 + x, color);
+    t.plot(x0 + y, y0 - x, color);
+    t.plot(x0 - y, y0 - x, color);
+  }
+}
+
+template <class Target>
+void SSD1306_Render<Target>::circleHelper(Target &t, int16_t x0, int16_t y0,
+                                          int16_t r, uint8_t cornername, uint16_t color) {
+  int16_t f     = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x     = 0;
+  int16_t y     = r;
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f     += ddF_x;
+    if (cornername & 0x4) {
+      t.plot(x0 + x, y0 + y, color);
+      t.plot(x0 + y, y0 + x, color);
+    }
+    if (cornername & 0x2) {
+      t.plot(x0 + x, y0 - y, color);
+      t.plot(x0 + y, y0 - x, color);
+    }
+    if (cornername & 0x8) {
+      t.plot(x0 - y, y0 + x, color);
+      t.plot(x0 - x, y0 + y, color);
+    }
+    if (cornername & 0x1) {
+      t.plot(x0 - y, y0 - x, color);
+      t.plot(x0 - x, y0 - y, color);
+    }
+  }
+}
+
+template <class Target>
+void SSD1306_Render<Target>::fillCircle(Target &t, int16_t x0, int16_t y0,
+                                        int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLCIRCLE);
+  t.vspan(x0, y0 - r, 2 * r + 1, color);
+  fillCircleHelper(t, x0, y0, r, 3, 0, color);
+}
+
+// Used to do circles and roundrects
+template <class Target>
+void SSD1306_Render<Target>::fillCircleHelper(Target &t, int16_t x0, int16_t y0, int16_t r,
+                                              uint8_t cornername, int16_t delta, uint16_t color) {
+  int16_t f     = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x     = 0;
+  int16_t y     = r;
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f     += ddF_x;
+
+    if (cornername & 0x1) {
+      t.vspan(x0 + x, y0 - y, 2 * y + 1 + delta, color);
+      t.vspan(x0 + y, y0 - x, 2 * x + 1 + delta, color);
+    }
+    if (cornername & 0x2) {
+      t.vspan(x0 - x, y0 - y, 2 * y + 1 + delta, color);
+      t.vspan(x0 - y, y0 - x, 2 * x + 1 + delta, color);
+    }
+  }
+}
+
+template <class Target>
+void SSD1306_Render<Target>::triangle(Target &t, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                      int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_TRIANGLE);
+  line(t, x0, y0, x1, y1, color);
+  line(t, x1, y1, x2, y2, color);
+  line(t, x2, y2, x0, y0, color);
+}
+
+// Scanline fill, as Adafruit_GFX::fillTriangle
+// Start k scanlines down from x0; only a clipped start needs a second
+// divide
+template <class Target>
+void SSD1306_Render<Target>::Edge::start(int16_t x0, int32_t dx, int32_t dy, int32_t k) {
+  uint32_t m = (dx < 0) ? -dx : dx;
+  carry = (dx < 0) ? -1 : 1;
+  whole = carry * (int32_t) (m / dy);
+  rem = m % dy;
+  x = x0;
+  acc = 0;
+  if (k > 0) {
+    uint32_t along = m * k;
+    x += carry * (int32_t) (along / dy);
+    acc = along % dy;
+  }
+  this->dy = dy;
+}
+
+// The pixels a to b (either way round) of row y, clipped to width w
+template <class Target>
+inline void SSD1306_Render<Target>::fillSpan(Target &t, int32_t a, int32_t b, int16_t y,
+                                             int16_t w, uint16_t color) {
+  if (a > b) GFXswap(a, b);
+  if (a < 0) a = 0;
+  if (b >= w) b = w - 1;
+  if (a <= b) t.hrun(a, y, b - a + 1, color);
+}
+
+// Adafruit_GFX's scanline fill with its per row divides replaced by edges
+// stepped in whole and remainder parts, so the spans are the same.  Rows
+// off the top or bottom are skipped before the loop, each span goes to the
+// target already clipped, and the covered rectangle is marked dirty once.
+template <class Target>
+void SSD1306_Render<Target>::fillTriangle(Target &t, int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                          int16_t x2, int16_t y2, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLTRIANGLE);
+
+  // Sort coordinates by Y order (y2 >= y1 >= y0)
+  if (y0 > y1) {
+    GFXswap(y0, y1); GFXswap(x0, x1);
+  }
+  if (y1 > y2) {
+    GFXswap(y2, y1); GFXswap(x2, x1);
+  }
+  if (y0 > y1) {
+    GFXswap(y0, y1); GFXswap(x0, x1);
+  }
+
+  int16_t w = t.width(), h = t.height();
+  if (y2 < 0 || y0 >= h) return;
+
+  int16_t a = x0, b = x0;
+  if (x1 < a)      a = x1;
+  else if (x1 > b) b = x1;
+  if (x2 < a)      a = x2;
+  else if (x2 > b) b = x2;
+  if (b < 0 || a >= w) return;
+
+  if (y0 == y2) { // all on the same line
+    fillSpan(t, a, b, y0, w, color);
+    t.mark(a < 0 ? 0 : a, y0, b >= w ? w - 1 : b, y0);
+    return;
+  }
+
+  // The upper part takes scanline y1 only for a flat bottomed triangle;
+  // otherwise the lower part does, which keeps both clear of a /0
+  int16_t last = (y1 == y2) ? y1 : y1 - 1;
+  int16_t top = (y0 < 0) ? 0 : y0;
+  int16_t bottom = (y2 >= h) ? h - 1 : y2;
+  int16_t y = top;
+
+  // The long edge runs y0 to y2; the short one is y0 to y1 and then, from
+  // the row after last, y1 to y2
+  Edge shortEdge, longEdge;
+  longEdge.start(x0, x2 - x0, y2 - y0, y - y0);
+  if (y <= last) shortEdge.start(x0, x1 - x0, y1 - y0, y - y0);
+  else           shortEdge.start(x1, x2 - x1, y2 - y1, y - y1);
+
+  for (; y <= bottom; y++) {
+    fillSpan(t, shortEdge.x, longEdge.x, y, w, color);
+    if (y == last && y1 < y2) shortEdge.start(x1, x2 - x1, y2 - y1, 0);
+    else                      shortEdge.step();
+    longEdge.step();
+  }
+
+  t.mark(a < 0 ? 0 : a, top, b >= w ? w - 1 : b, bottom);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::roundRect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h,
+                                       int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_ROUNDRECT);
+  t.hspan(x + r    , y        , w - 2 * r, color); // Top
+  t.hspan(x + r    , y + h - 1, w - 2 * r, color); // Bottom
+  t.vspan(x        , y + r    , h - 2 * r, color); // Left
+  t.vspan(x + w - 1, y + r    , h - 2 * r, color); // Right
+  // draw four corners
+  circleHelper(t, x + r        , y + r        , r, 1, color);
+  circleHelper(t, x + w - r - 1, y + r        , r, 2, color);
+  circleHelper(t, x + w - r - 1, y + h - r - 1, r, 4, color);
+  circleHelper(t, x + r        , y + h - r - 1, r, 8, color);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::fillRoundRect(Target &t, int16_t x, int16_t y, int16_t w, int16_t h,
+                                           int16_t r, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_FILLROUNDRECT);
+  fillRect(t, x + r, y, w - 2 * r, h, color);
+
+  // draw four corners
+  fillCircleHelper(t, x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
+  fillCircleHelper(t, x + r        , y + r, r, 2, h - 2 * r - 1, color);
+}
+
+template <class Target>
+void SSD1306_Render<Target>::bitmap(Target &t, int16_t x, int16_t y, const uint8_t *bitmap,
+                                    int16_t w, int16_t h, uint16_t color) {
+  SSD1306_PERF_CALL(SSD1306_PERF_BITMAP);
+  int16_t byteWidth = (w + 7) / 8;
+
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (bitmap[j * byteWidth + i / 8] & (128 >> (i & 7))) {
+        t.plot(x + i, y + j, color);
+      }
+    }
+  }
+}
+
+template <class Target>
+void SSD1306_Render<Target>::bitmap(Target &t, int16_t x, int16_t y, const uint8_t *bitmap,
+                                    int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+  SSD1306_PERF_CALL(SSD1306_PERF_BITMAP);
+  int16_t byteWidth = (w + 7) / 8;
+
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (bitmap[j * byteWidth + i / 8] & (128 >> (i & 7))) {
+        t.plot(x + i, y + j, color);
+      } else {
+        t.plot(x + i, y + j, bg);
+      }
+    }
+  }
+}
+
+template <class Target>
+void SSD1306_Render<Target>::character(Target &t, int16_t x, int16_t y, const unsigned char *glyph,
+                                       uint16_t color, uint16_t bg, uint8_t size) {
+  SSD1306_PERF_CALL(SSD1306_PERF_CHAR);
+
+  if ((x >= t.width())            || // Clip right
+      (y >= t.height())           || // Clip bottom
+      ((x + 6 * size - 1) < 0)    || // Clip left
+      ((y + 8 * size - 1) < 0))      // Clip top
+    return;
+
+  for (int8_t i = 0; i < 6; i++) {
+    uint8_t line = (i == 5) ? 0 : glyph[i];
+    for (int8_t j = 0; j < 8; j++) {
+      if (line & 0x1) {
+        if (size == 1) {
+          t.plot(x + i, y + j, color);
+        } else {
+          fillRect(t, x + i * size, y + j * size, size, size, color);
+        }
+      } else if (bg != color) {
+        if (size == 1) {
+          t.plot(x + i, y + j, bg);
+        } else {
+          fillRect(t, x + i * size, y + j * size, size, size, bg);
+        }
+      }
+      line >>= 1;
+    }
+  }
+}
+
+#endif /* _SSD1306_Render_H_ */
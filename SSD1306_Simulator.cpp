@@ -0,0 +1,355 @@
+/*********************************************************************
+Host-side SSD1306 panel simulator
+*********************************************************************/
+
+#include "SSD1306_Simulator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Panel frames per scroll step, indexed by the interval setting
+static const uint16_t scrollIntervals[8] = { 5, 64, 128, 256, 3, 4, 25, 2 };
+
+SSD1306_Simulator::SSD1306_Simulator() {
+  reset();
+}
+
+// Power-on defaults from the datasheet.  GDDRAM isn't cleared by a reset
+// on the real part, so fill it with junk: anything display() forgets to
+// send shows up in the rendered frame.
+void SSD1306_Simulator::reset() {
+  uint32_t junk = 0x2545F491;
+  for (uint8_t p = 0; p < SSD1306_SIM_PAGES; p++) {
+    for (uint8_t x = 0; x < SSD1306_SIM_WIDTH; x++) {
+      junk ^= junk << 13;
+      junk ^= junk >> 17;
+      junk ^= junk << 5;
+      ram[p][x] = junk;
+    }
+  }
+
+  contrast      = 0x7F;
+  startLine     = 0;
+  displayOffset = 0;
+  multiplex     = 63;
+  memoryMode    = 2;
+  comPins       = 0x12;
+  displayOn     = false;
+  inverted      = false;
+  entireOn      = false;
+  segRemap      = false;
+  comScanDec    = false;
+  chargePump    = false;
+  scrolling     = false;
+
+  colStart = 0;  colEnd  = SSD1306_SIM_WIDTH - 1;
+  pageStart = 0; pageEnd = SSD1306_SIM_PAGES - 1;
+  col = 0;       page    = 0;
+
+  argCount = argNeeded = 0;
+  scrollCmd = 0;
+  scrollStartPage = scrollEndPage = scrollInterval = scrollVOffset = 0;
+  vScrollTop = 0;
+  vScrollRows = SSD1306_SIM_HEIGHT;
+  scrollFrames = 0;
+
+  transactions = commandBytes = dataBytes = unknownCommands = 0;
+}
+
+void SSD1306_Simulator::sendCommands(char *bytes, uint16_t len) {
+  transactions++;
+  commandBytes += len;
+  while (len--) {
+    command((uint8_t) *bytes++);
+  }
+}
+
+void SSD1306_Simulator::sendData(char *bytes, uint16_t len) {
+  transactions++;
+  dataBytes += len;
+  while (len--) {
+    data((uint8_t) *bytes++);
+  }
+}
+
+// The parser keeps its state between transactions, like the controller:
+// a command's arguments may arrive in later writes.
+void SSD1306_Simulator::command(uint8_t c) {
+  if (argCount < argNeeded) {
+    args[argCount++] = c;
+    if (argCount == argNeeded) execute();
+    return;
+  }
+
+  cmd = c;
+  argCount = 0;
+  switch (c) {
+    case 0x81: case 0x20: case 0xA8: case 0xD3: case 0xD5:
+    case 0xD9: case 0xDA: case 0xDB: case 0x8D:
+      argNeeded = 1; break;
+    case 0x21: case 0x22: case 0xA3:
+      argNeeded = 2; break;
+    case 0x26: case 0x27:
+      argNeeded = 6; break;
+    case 0x29: case 0x2A:
+      argNeeded = 5; break;
+    default:
+      argNeeded = 0; break;
+  }
+  if (argNeeded == 0) execute();
+}
+
+void SSD1306_Simulator::execute(void) {
+  argNeeded = argCount = 0;
+
+  switch (cmd) {
+    case 0x81: contrast = args[0]; return;
+    case 0x20: memoryMode = args[0] & 3; return;
+    case 0x21:
+      colStart = args[0] & 0x7F;
+      colEnd   = args[1] & 0x7F;
+      col      = colStart;
+      return;
+    case 0x22:
+      pageStart = args[0] & 7;
+      pageEnd   = args[1] & 7;
+      page      = pageStart;
+      return;
+    case 0xA8: multiplex = args[0] & 0x3F; return;
+    case 0xD3: displayOffset = args[0] & 0x3F; return;
+    case 0xDA: comPins = args[0]; return;
+    case 0x8D: chargePump = (args[0] & 0x04) != 0; return;
+    case 0xD5: case 0xD9: case 0xDB: return; // timing only
+    case 0xA3:
+      vScrollTop  = args[0] & 0x3F;
+      vScrollRows = args[1] & 0x7F;
+      return;
+    case 0x26: case 0x27:
+      scrollCmd       = cmd;
+      scrollStartPage = args[1] & 7;
+      scrollInterval  = args[2] & 7;
+      scrollEndPage   = args[3] & 7;
+      scrollVOffset   = 0;
+      return;
+    case 0x29: case 0x2A:
+      scrollCmd       = cmd;
+      scrollStartPage = args[1] & 7;
+      scrollInterval  = args[2] & 7;
+      scrollEndPage   = args[3] & 7;
+      scrollVOffset   = args[4] & 0x3F;
+      return;
+    case 0x2E: scrolling = false; scrollFrames = 0; return;
+    case 0x2F: scrolling = true; scrollFrames = 0; return;
+    case 0xA0: case 0xA1: segRemap = cmd & 1; return;
+    case 0xA4: case 0xA5: entireOn = cmd & 1; return;
+    case 0xA6: case 0xA7: inverted = cmd & 1; return;
+    case 0xAE: case 0xAF: displayOn = cmd & 1; return;
+    case 0xC0: comScanDec = false; return;
+    case 0xC8: comScanDec = true; return;
+    case 0xE3: return; // NOP
+  }
+
+  if (cmd >= 0x40 && cmd <= 0x7F) {
+    startLine = cmd & 0x3F;
+  } else if (cmd >= 0xB0 && cmd <= 0xB7) {
+    page = cmd & 7;
+  } else if (cmd <= 0x0F) {
+    col = (col & 0xF0) | (cmd & 0x0F);
+  } else if (cmd <= 0x1F) {
+    col = (col & 0x0F) | ((cmd & 0x07) << 4);
+  } else {
+    unknownCommands++;
+  }
+}
+
+void SSD1306_Simulator::data(uint8_t b) {
+  ram[page][col] = b;
+
+  switch (memoryMode) {
+    case 0: // horizontal
+      if (col++ == colEnd) {
+        col = colStart;
+        page = (page == pageEnd) ? pageStart : page + 1;
+      }
+      break;
+    case 1: // vertical
+      if (page++ == pageEnd) {
+        page = pageStart;
+        col = (col == colEnd) ? colStart : col + 1;
+      }
+      break;
+    default: // page
+      col = (col + 1) & 0x7F;
+      break;
+  }
+}
+
+// Horizontal scrolling really moves GDDRAM columns on the controller, which
+// is why the driver has to resend after stopping.  Vertical scrolling only
+// moves the window onto RAM; it is applied in render().
+void SSD1306_Simulator::advanceFrames(uint32_t n) {
+  if (!scrolling || scrollCmd == 0) return;
+
+  uint16_t interval = scrollIntervals[scrollInterval];
+  uint32_t before = scrollFrames / interval;
+  scrollFrames += n;
+  uint32_t steps = scrollFrames / interval - before;
+
+  bool right = (scrollCmd == 0x26 || scrollCmd == 0x29);
+  while (steps--) {
+    for (uint8_t p = scrollStartPage; p <= scrollEndPage && p < SSD1306_SIM_PAGES; p++) {
+      if (right) {
+        uint8_t last = ram[p][SSD1306_SIM_WIDTH - 1];
+        memmove(&ram[p][1], &ram[p][0], SSD1306_SIM_WIDTH - 1);
+        ram[p][0] = last;
+      } else {
+        uint8_t first = ram[p][0];
+        memmove(&ram[p][0], &ram[p][1], SSD1306_SIM_WIDTH - 1);
+        ram[p][SSD1306_SIM_WIDTH - 1] = first;
+      }
+    }
+  }
+}
+
+// Is the pixel at screen (x, y) lit?  y counts COM lines from the top.
+uint8_t SSD1306_Simulator::pixel(int16_t x, int16_t y) const {
+  if (!displayOn) return 0;
+
+  uint8_t com = comScanDec ? y : multiplex - y;
+  if (com > multiplex) return 0;
+
+  uint8_t row = (com + startLine + displayOffset) & 0x3F;
+  if (scrolling && scrollVOffset && com >= vScrollTop && com < vScrollTop + vScrollRows) {
+    uint32_t steps = scrollFrames / scrollIntervals[scrollInterval];
+    row = (row + steps * scrollVOffset) & 0x3F;
+  }
+
+  uint8_t c = segRemap ? x : SSD1306_SIM_WIDTH - 1 - x;
+  bool on = entireOn || (ram[row >> 3][c] >> (row & 7)) & 1;
+  return on != inverted;
+}
+
+void SSD1306_Simulator::render(uint8_t *pixels) const {
+  for (int16_t y = 0; y < SSD1306_SIM_HEIGHT; y++) {
+    for (int16_t x = 0; x < SSD1306_SIM_WIDTH; x++) {
+      *pixels++ = pixel(x, y);
+    }
+  }
+}
+
+// Plain PBM (P4).  In PBM a set bit is black, so lit pixels are 0.
+bool SSD1306_Simulator::writePBM(const char *path) const {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+
+  fprintf(f, "P4\n%d %d\n", SSD1306_SIM_WIDTH, SSD1306_SIM_HEIGHT);
+  for (int16_t y = 0; y < SSD1306_SIM_HEIGHT; y++) {
+    for (int16_t x = 0; x < SSD1306_SIM_WIDTH; x += 8) {
+      uint8_t b = 0;
+      for (uint8_t i = 0; i < 8; i++) {
+        if (!pixel(x + i, y)) b |= 0x80 >> i;
+      }
+      fputc(b, f);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *p, size_t n) {
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    for (uint8_t k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void writeChunk(FILE *f, const char *type, const uint8_t *data, uint32_t len) {
+  uint8_t head[8];
+  put32(head, len);
+  memcpy(head + 4, type, 4);
+  fwrite(head, 1, 8, f);
+  fwrite(data, 1, len, f);
+  uint32_t crc = crc32(crc32(0, head + 4, 4), data, len);
+  put32(head, crc);
+  fwrite(head, 1, 4, f);
+}
+
+// 8 bit greyscale PNG, each panel pixel drawn as a scale x scale block.
+// Lit pixels get brighter with the contrast setting.  The image data is
+// stored uncompressed, so no zlib is needed.
+bool SSD1306_Simulator::writePNG(const char *path, uint8_t scale) const {
+  if (scale == 0) scale = 1;
+  uint32_t w = SSD1306_SIM_WIDTH * scale, h = SSD1306_SIM_HEIGHT * scale;
+  uint8_t lit = 0x40 + (contrast * 0xBF) / 0xFF;
+
+  // filter byte + row, for every row
+  uint32_t rawLen = (w + 1) * h;
+  uint8_t *raw = (uint8_t *) malloc(rawLen);
+  if (!raw) return false;
+  for (uint32_t y = 0; y < h; y++) {
+    uint8_t *row = raw + y * (w + 1);
+    row[0] = 0;
+    for (uint32_t x = 0; x < w; x++) {
+      row[1 + x] = pixel(x / scale, y / scale) ? lit : 0;
+    }
+  }
+
+  // zlib stream of stored deflate blocks
+  uint32_t blocks = (rawLen + 65534) / 65535;
+  uint32_t zLen = 2 + blocks * 5 + rawLen + 4;
+  uint8_t *z = (uint8_t *) malloc(zLen);
+  if (!z) {
+    free(raw);
+    return false;
+  }
+  uint8_t *q = z;
+  *q++ = 0x78;
+  *q++ = 0x01;
+  uint32_t a = 1, b = 0;
+  for (uint32_t off = 0; off < rawLen; ) {
+    uint16_t n = (rawLen - off > 65535) ? 65535 : rawLen - off;
+    *q++ = (off + n == rawLen) ? 1 : 0;
+    *q++ = n & 0xFF;
+    *q++ = n >> 8;
+    *q++ = ~n & 0xFF;
+    *q++ = (~n >> 8) & 0xFF;
+    memcpy(q, raw + off, n);
+    for (uint16_t i = 0; i < n; i++) {
+      a = (a + q[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    q += n;
+    off += n;
+  }
+  put32(q, (b << 16) | a);
+
+  FILE *f = fopen(path, "wb");
+  bool ok = (f != NULL);
+  if (ok) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    uint8_t ihdr[13];
+    put32(ihdr, w);
+    put32(ihdr + 4, h);
+    ihdr[8]  = 8;  // bit depth
+    ihdr[9]  = 0;  // greyscale
+    ihdr[10] = 0;  // deflate
+    ihdr[11] = 0;  // adaptive filtering
+    ihdr[12] = 0;  // no interlace
+    fwrite(signature, 1, 8, f);
+    writeChunk(f, "IHDR", ihdr, 13);
+    writeChunk(f, "IDAT", z, zLen);
+    writeChunk(f, "IEND", NULL, 0);
+    ok = (fclose(f) == 0);
+  }
+
+  free(z);
+  free(raw);
+  return ok;
+}
@@ -0,0 +1,84 @@
+/*********************************************************************
+Host-side SSD1306 panel simulator
+
+A transport that decodes the command stream the driver sends the way the
+controller would (addressing windows and modes, start line, display
+offset, remap, scrolling, invert, contrast, display on/off) into an
+emulated 128x64 GDDRAM, and renders what the glass would show to PBM or
+PNG files.  Host builds only (SSD1306_HOST): it uses stdio.
+
+Orientation follows the driver's init(): with segment remap and COM scan
+decrement on, GDDRAM column 0 / row 0 is the top left of the image.
+*********************************************************************/
+
+#ifndef _SSD1306_Simulator_H_
+#define _SSD1306_Simulator_H_
+
+#include "SSD1306_Transport.h"
+
+#define SSD1306_SIM_WIDTH  128
+#define SSD1306_SIM_HEIGHT 64
+#define SSD1306_SIM_PAGES  (SSD1306_SIM_HEIGHT / 8)
+
+class SSD1306_Simulator : public SSD1306_Transport {
+ public:
+  SSD1306_Simulator();
+
+  virtual void reset();
+  virtual void sendCommands(char *bytes, uint16_t len);
+  virtual void sendData(char *bytes, uint16_t len);
+
+  // Let n panel frames go by; only matters while scrolling is active
+  void advanceFrames(uint32_t n);
+
+  // What the panel shows right now, one byte per pixel (0 = off), row
+  // major, SSD1306_SIM_WIDTH x SSD1306_SIM_HEIGHT
+  void render(uint8_t *pixels) const;
+
+  bool writePBM(const char *path) const;
+  bool writePNG(const char *path, uint8_t scale = 1) const;
+
+  // Raw controller state, for checking what display() really sent
+  uint8_t ram[SSD1306_SIM_PAGES][SSD1306_SIM_WIDTH];
+  uint8_t
+    contrast,
+    startLine,
+    displayOffset,
+    multiplex,
+    memoryMode,
+    comPins;
+  bool
+    displayOn,
+    inverted,
+    entireOn,
+    segRemap,
+    comScanDec,
+    chargePump,
+    scrolling;
+
+  // Bus statistics since the last reset()
+  uint32_t
+    transactions,
+    commandBytes,
+    dataBytes,
+    unknownCommands;
+
+ private:
+  // addressing window and pointer
+  uint8_t colStart, colEnd, pageStart, pageEnd, col, page;
+
+  // command parser: current command and the arguments still to come
+  uint8_t cmd, args[6], argCount, argNeeded;
+
+  // scroll setup as last programmed, and how far it has moved
+  uint8_t scrollCmd, scrollStartPage, scrollEndPage, scrollInterval, scrollVOffset;
+  uint8_t vScrollTop, vScrollRows;
+  uint32_t scrollFrames;
+
+  void command(uint8_t c);
+  void execute(void);
+  void data(uint8_t b);
+  uint8_t pixel(int16_t x, int16_t y) const;
+};
+
+#endif /* _SSD1306_Simulator_H_ */
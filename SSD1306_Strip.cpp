@@ -0,0 +1,163 @@
+/*********************************************************************
+Page-at-a-time (strip) rendering for SSD1306 panels
+*********************************************************************/
+
+#include "SSD1306_Strip.h"
+
+#define SSD1306_TEMPLATE template <int16_t W, int16_t H, uint8_t COMPINS, uint8_t COLOFFSET>
+#define SSD1306_STRIP Adafruit_SSD1306_Strip<W, H, COMPINS, COLOFFSET>
+
+SSD1306_TEMPLATE
+SSD1306_STRIP::Adafruit_SSD1306_Strip(SSD1306_Transport &transport) :
+  Adafruit_GFX(W, H), transport(transport), band(0xFF) {
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::init(void)
+{
+  transport.reset();
+
+  char seq[1 + SSD1306_INIT_LEN];
+  uint8_t n = ssd1306_initSequence(seq + 1, H, COMPINS);
+  transport.sendCommands(seq + 1, n);
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::render(const SSD1306_DisplayList &list)
+{
+  char window[1 + 6] = {
+    0,
+    SSD1306_COLUMNADDR, COLOFFSET, (char) (COLOFFSET + W - 1),
+    SSD1306_PAGEADDR, 0, PAGES - 1
+  };
+
+  SSD1306_Bus::acquire();
+  SSD1306_PERF_ADD(transactions, 1);
+  SSD1306_PERF_ADD(commandBytes, 6);
+  transport.sendCommands(window + 1, 6);
+
+  // the window wraps from page to page by itself, so the pages just go
+  // out one after another
+  for (band = 0; band < PAGES; band++) {
+    memset(page.data, 0, W);
+
+    // replay only what can reach this page: its rows, in logical
+    // coordinates
+    int16_t top = band * 8, flipped = H - 8 - band * 8;
+    switch (getRotation()) {
+    case 0: list.replay(*this, 0, top, width(), 8); break;
+    case 1: list.replay(*this, top, 0, 8, height()); break;
+    case 2: list.replay(*this, 0, flipped, width(), 8); break;
+    case 3: list.replay(*this, flipped, 0, 8, height()); break;
+    }
+    SSD1306_PERF_ADD(transactions, 1);
+    SSD1306_PERF_ADD(dataBytes, W);
+    transport.sendData(page.data, W);
+  }
+  band = 0xFF;
+  SSD1306_Bus::release();
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if ((x < 0) || (x >= width()) || (y < 0) || (y >= height()))
+    return;
+
+  // check rotation, move pixel around if necessary
+  switch (getRotation()) {
+  case 1:
+    GFXswap(x, y);
+    x = W - x - 1;
+    break;
+  case 2:
+    x = W - x - 1;
+    y = H - y - 1;
+    break;
+  case 3:
+    GFXswap(x, y);
+    y = H - y - 1;
+    break;
+  }
+
+  if ((y >> 3) != band) return;
+  SSD1306_PERF_ADD(pixels, 1);
+
+  switch (color)
+  {
+    case WHITE:   page.data[x] |=  (1 << (y&7)); break;
+    case BLACK:   page.data[x] &= ~(1 << (y&7)); break;
+    case INVERSE: page.data[x] ^=  (1 << (y&7)); break;
+  }
+}
+
+// Rotation turns logical horizontal lines into panel ones or vertical ones;
+// either way the clipping happens in panel coordinates.
+SSD1306_TEMPLATE
+void SSD1306_STRIP::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  switch (getRotation()) {
+  case 0: hline(x, y, w, color); break;
+  case 1: vline(W - 1 - y, x, w, color); break;
+  case 2: hline(W - x - w, H - 1 - y, w, color); break;
+  case 3: vline(y, H - x - w, w, color); break;
+  }
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  switch (getRotation()) {
+  case 0: vline(x, y, h, color); break;
+  case 1: hline(W - y - h, x, h, color); break;
+  case 2: vline(W - 1 - x, H - y - h, h, color); break;
+  case 3: hline(y, H - 1 - x, h, color); break;
+  }
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::hline(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  if (y < 0 || (y >> 3) != band) return;
+  if (x < 0) { w += x; x = 0; }
+  if (x + w > W) w = W - x;
+  if (w <= 0) return;
+  SSD1306_PERF_ADD(spans, 1);
+  SSD1306_PERF_ADD(spanPixels, w);
+
+  char *p = page.data + x;
+  uint8_t mask = 1 << (y & 7);
+  switch (color)
+  {
+  case WHITE:                 while (w--) { *p++ |= mask; } break;
+  case BLACK:   mask = ~mask; while (w--) { *p++ &= mask; } break;
+  case INVERSE:               while (w--) { *p++ ^= mask; } break;
+  }
+}
+
+SSD1306_TEMPLATE
+void SSD1306_STRIP::vline(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  if (x < 0 || x >= W) return;
+
+  // clip to the rows of this page
+  int16_t top = band * 8;
+  int16_t y1 = y + h - 1;
+  if (y < top) y = top;
+  if (y1 > top + 7) y1 = top + 7;
+  if (y1 < y) return;
+  SSD1306_PERF_ADD(spans, 1);
+  SSD1306_PERF_ADD(spanPixels, y1 - y + 1);
+
+  uint8_t mask = (0xFF << (y & 7)) & (0xFF >> (7 - (y1 & 7)));
+  switch (color)
+  {
+  case WHITE:   page.data[x] |=  mask; break;
+  case BLACK:   page.data[x] &= ~mask; break;
+  case INVERSE: page.data[x] ^=  mask; break;
+  }
+}
+
+template class Adafruit_SSD1306_Strip<128, 64, SSD1306_COMPINS_ALT>;
+template class Adafruit_SSD1306_Strip<128, 32, SSD1306_COMPINS_SEQ>;
+template class Adafruit_SSD1306_Strip<64, 48, SSD1306_COMPINS_ALT>;
@@ -0,0 +1,59 @@
+/*********************************************************************
+Page-at-a-time (strip) rendering for SSD1306 panels
+
+Adafruit_SSD1306_Strip draws a frame without a framebuffer.  The scene is
+recorded into an SSD1306_DisplayList; render() then replays the list once
+for each 8 row page into a single page buffer, clipping everything to the
+page, and streams each finished page to the panel.  The display needs one
+page of RAM (plus the list) instead of a whole frame, and pays for it with
+a replay per page; commands whose bounding box misses a page are skipped
+for that page.
+
+It is an Adafruit_GFX so the list replays onto it; drawing on it directly
+outside render() has no effect.
+*********************************************************************/
+
+#ifndef _SSD1306_Strip_H_
+#define _SSD1306_Strip_H_
+
+#include "Adafruit_SSD1306.h"
+#include "SSD1306_DisplayList.h"
+
+template <int16_t W, int16_t H, uint8_t COMPINS, uint8_t COLOFFSET = (128 - W) / 2>
+class Adafruit_SSD1306_Strip : public Adafruit_GFX {
+ public:
+  static const uint8_t PAGES = H / 8;
+
+  Adafruit_SSD1306_Strip(SSD1306_Transport &transport);
+
+  void init(void);
+
+  // Draw list onto a cleared screen and send it, page by page
+  void render(const SSD1306_DisplayList &list);
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+
+ private:
+  SSD1306_Transport &transport;
+
+  // The page being rendered, with a spare word in front for the transport
+  struct Page {
+    char pad[4];
+    char data[W];
+  } __attribute__((aligned(4)));
+  Page page;
+
+  // Page number being rendered; 0xFF outside render()
+  uint8_t band;
+
+  void hline(int16_t x, int16_t y, int16_t w, uint16_t color);
+  void vline(int16_t x, int16_t y, int16_t h, uint16_t color);
+};
+
+typedef Adafruit_SSD1306_Strip<128, 64, SSD1306_COMPINS_ALT> Adafruit_SSD1306_Strip128x64;
+typedef Adafruit_SSD1306_Strip<128, 32, SSD1306_COMPINS_SEQ> Adafruit_SSD1306_Strip128x32;
+typedef Adafruit_SSD1306_Strip<64, 48, SSD1306_COMPINS_ALT> Adafruit_SSD1306_Strip64x48;
+
+#endif /* _SSD1306_Strip_H_ */
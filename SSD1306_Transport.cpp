@@ -0,0 +1,119 @@
+/*********************************************************************
+Bus transports for the SSD1306 driver
+*********************************************************************/
+
+#include "SSD1306_Transport.h"
+#include <string.h>
+
+SSD1306_Recorder::SSD1306_Recorder(uint8_t *storage, uint16_t capacity) :
+  storage(storage), capacity(capacity) {
+  clear();
+}
+
+void SSD1306_Recorder::clear(void) {
+  used = 0;
+  transactions = commandBytes = dataBytes = dropped = 0;
+}
+
+void SSD1306_Recorder::record(uint8_t type, const char *bytes, uint16_t len) {
+  transactions++;
+  if ((uint32_t) used + 3 + len > capacity) {
+    dropped++;
+    return;
+  }
+  storage[used++] = type;
+  storage[used++] = len & 0xFF;
+  storage[used++] = len >> 8;
+  memcpy(storage + used, bytes, len);
+  used += len;
+}
+
+void SSD1306_Recorder::reset() {
+  record(SSD1306_REC_RESET, NULL, 0);
+}
+
+void SSD1306_Recorder::sendCommands(char *bytes, uint16_t len) {
+  commandBytes += len;
+  record(SSD1306_REC_COMMAND, bytes, len);
+}
+
+void SSD1306_Recorder::sendData(char *bytes, uint16_t len) {
+  dataBytes += len;
+  record(SSD1306_REC_DATA, bytes, len);
+}
+
+uint16_t SSD1306_Recorder::read(uint16_t pos, uint8_t &type, const uint8_t *&bytes, uint16_t &len) const {
+  if (pos + 3 > used) return 0;
+  type  = storage[pos];
+  len   = storage[pos + 1] | (storage[pos + 2] << 8);
+  bytes = storage + pos + 3;
+  return pos + 3 + len;
+}
+
+#ifndef SSD1306_HOST
+
+SSD1306_I2C::SSD1306_I2C(MicroBitI2C &i2c, MicroBitPin &rst, uint8_t address) :
+  i2c(i2c), rst(rst), address(address) {
+}
+
+MicroBitPin *SSD1306_I2C::pulsed = NULL;
+
+void SSD1306_I2C::reset() {
+  if (pulsed == &rst) return;
+  pulsed = &rst;
+  rst.setDigitalValue(1);
+  fiber_sleep(10);
+  rst.setDigitalValue(0);
+  fiber_sleep(10);
+  rst.setDigitalValue(1);
+  fiber_sleep(100);
+}
+
+// Borrow the byte in front of the payload for the control byte, so the
+// whole run goes out in one write without a copy
+void SSD1306_I2C::write(uint8_t control, char *bytes, uint16_t len) {
+  char saved = bytes[-1];
+  bytes[-1] = (char) control;
+  i2c.write(address, bytes - 1, len + 1, false);
+  bytes[-1] = saved;
+}
+
+void SSD1306_I2C::sendCommands(char *bytes, uint16_t len) {
+  write(SSD1306_CONTROL_COMMAND, bytes, len);
+}
+
+void SSD1306_I2C::sendData(char *bytes, uint16_t len) {
+  write(SSD1306_CONTROL_DATA, bytes, len);
+}
+
+SSD1306_SPI::SSD1306_SPI(SPI &spi, MicroBitPin &dc, MicroBitPin &cs, MicroBitPin &rst) :
+  spi(spi), dc(dc), cs(cs), rst(rst) {
+  cs.setDigitalValue(1);
+}
+
+void SSD1306_SPI::reset() {
+  rst.setDigitalValue(1);
+  fiber_sleep(1);
+  rst.setDigitalValue(0);
+  fiber_sleep(10);
+  rst.setDigitalValue(1);
+}
+
+void SSD1306_SPI::write(int dcLevel, const char *bytes, uint16_t len) {
+  dc.setDigitalValue(dcLevel);
+  cs.setDigitalValue(0);
+  while (len--) {
+    spi.write((uint8_t) *bytes++);
+  }
+  cs.setDigitalValue(1);
+}
+
+void SSD1306_SPI::sendCommands(char *bytes, uint16_t len) {
+  write(0, bytes, len);
+}
+
+void SSD1306_SPI::sendData(char *bytes, uint16_t len) {
+  write(1, bytes, len);
+}
+
+#endif /* SSD1306_HOST */
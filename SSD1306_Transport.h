@@ -0,0 +1,118 @@
+/*********************************************************************
+Bus transports for the SSD1306 driver
+
+The driver never talks to a bus directly; it hands command and GDDRAM
+data bytes to a transport.  SSD1306_I2C and SSD1306_SPI drive real
+panels on the micro:bit, SSD1306_Recorder captures the byte stream in
+memory so the driver can be built and checked on a host with no
+hardware (define SSD1306_HOST for such builds).
+*********************************************************************/
+
+#ifndef _SSD1306_Transport_H_
+#define _SSD1306_Transport_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef SSD1306_HOST
+#include "pxt.h"
+#endif
+
+#define SSD1306_I2C_ADDRESS     0x7A  // 011110(6bit address)+1(SA0)+0(RW) -
+#define SSD1306_I2C_ADDRESS_ALT 0x78  // SA0 tied low
+
+// I2C control bytes, sent in front of a run of command or data bytes
+#define SSD1306_CONTROL_COMMAND 0x00
+#define SSD1306_CONTROL_DATA    0x40
+
+class SSD1306_Transport {
+ public:
+  virtual ~SSD1306_Transport() {}
+
+  // Pulse the panel's reset line and wait for it to come back up
+  virtual void reset() = 0;
+
+  // Send len command bytes / len GDDRAM data bytes.  The byte in front of
+  // bytes (bytes[-1]) is always writable scratch: a transport may borrow it
+  // for a control byte, but must put it back before returning.
+  virtual void sendCommands(char *bytes, uint16_t len) = 0;
+  virtual void sendData(char *bytes, uint16_t len) = 0;
+};
+
+// Records everything sent into caller supplied storage.  Each record is
+// a type byte (SSD1306_REC_*), a little endian 16 bit length and the
+// payload.  Records that don't fit are dropped and counted in 'dropped';
+// the transaction and byte counters always see everything.
+#define SSD1306_REC_RESET   'R'
+#define SSD1306_REC_COMMAND 'C'
+#define SSD1306_REC_DATA    'D'
+
+class SSD1306_Recorder : public SSD1306_Transport {
+ public:
+  SSD1306_Recorder(uint8_t *storage, uint16_t capacity);
+
+  virtual void reset();
+  virtual void sendCommands(char *bytes, uint16_t len);
+  virtual void sendData(char *bytes, uint16_t len);
+
+  void clear(void);
+
+  // Walk the log: start with pos = 0; returns the position of the next
+  // record, or 0 once there are no more.
+  uint16_t read(uint16_t pos, uint8_t &type, const uint8_t *&bytes, uint16_t &len) const;
+
+  const uint8_t *log(void) const { return storage; }
+  uint16_t length(void) const { return used; }
+
+  uint32_t
+    transactions,
+    commandBytes,
+    dataBytes,
+    dropped;
+
+ private:
+  uint8_t *storage;
+  uint16_t capacity, used;
+  void record(uint8_t type, const char *bytes, uint16_t len);
+};
+
+#ifndef SSD1306_HOST
+
+// I2C, as wired on the micro:bit breakout: reset on P0 by default.
+// Panels at the two addresses can share one reset line; it is only pulsed
+// by the first reset() on that pin, since a later pulse would also wipe the
+// panels already set up.  init() reprograms the controller either way.
+class SSD1306_I2C : public SSD1306_Transport {
+ public:
+  SSD1306_I2C(MicroBitI2C &i2c, MicroBitPin &rst, uint8_t address = SSD1306_I2C_ADDRESS);
+
+  virtual void reset();
+  virtual void sendCommands(char *bytes, uint16_t len);
+  virtual void sendData(char *bytes, uint16_t len);
+
+ private:
+  MicroBitI2C &i2c;
+  MicroBitPin &rst;
+  uint8_t address;
+  static MicroBitPin *pulsed;
+  void write(uint8_t control, char *bytes, uint16_t len);
+};
+
+// 4-wire SPI: D/C selects command or data, so no control bytes are needed
+class SSD1306_SPI : public SSD1306_Transport {
+ public:
+  SSD1306_SPI(SPI &spi, MicroBitPin &dc, MicroBitPin &cs, MicroBitPin &rst);
+
+  virtual void reset();
+  virtual void sendCommands(char *bytes, uint16_t len);
+  virtual void sendData(char *bytes, uint16_t len);
+
+ private:
+  SPI &spi;
+  MicroBitPin &dc, &cs, &rst;
+  void write(int dcLevel, const char *bytes, uint16_t len);
+};
+
+#endif /* SSD1306_HOST */
+
+#endif /* _SSD1306_Transport_H_ */
@@ -0,0 +1,235 @@
+// Host benchmark for the GFX primitives and the flush path
+//
+// Times each Adafruit_GFX primitive drawn into an Adafruit_SSD1306 buffer,
+// text at every size and rotation, and display() against a transport that
+// only counts what it is given.  Reports ns per call, pixels covered per
+// second and, for the flushes, bus traffic per frame.  Build with
+// "make bench", run as "host/bench [filter]" to run only the benchmarks
+// whose name contains filter.
+
+#include "Adafruit_SSD1306.h"
+#include "SSD1306_Strip.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Counts only: a recorder with no storage drops every record
+static SSD1306_Recorder bus(NULL, 0);
+static Adafruit_SSD1306 display(bus);
+static Adafruit_SSD1306_Strip128x64 strip(bus);
+static uint8_t listStorage[512];
+static SSD1306_DisplayList scene(listStorage, sizeof(listStorage));
+static const char *filter = NULL;
+static uint8_t textSize = 1;
+
+static const unsigned char logo16_glcd_bmp[] =
+{ 0b00000000, 0b11000000,
+  0b00000001, 0b11000000,
+  0b00000001, 0b11000000,
+  0b00000011, 0b11100000,
+  0b11110011, 0b11100000,
+  0b11111110, 0b11111000,
+  0b01111110, 0b11111111,
+  0b00110011, 0b10011111,
+  0b00011111, 0b11111100,
+  0b00001101, 0b01110000,
+  0b00011011, 0b10100000,
+  0b00111111, 0b11100000,
+  0b00111111, 0b11110000,
+  0b01111100, 0b11110000,
+  0b01110000, 0b01110000,
+  0b00000000, 0b00110000 };
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Lit pixels in the buffer
+static uint32_t litPixels(void) {
+  const uint8_t *buf = display.getBuffer();
+  uint32_t n = 0;
+  for (uint16_t i = 0; i < Adafruit_SSD1306::BUFSIZE; i++) {
+    n += __builtin_popcount(buf[i]);
+  }
+  return n;
+}
+
+// Run op until at least 50ms have gone by and return ns per call
+static double timeOp(void (*op)(uint32_t), uint32_t *calls) {
+  uint32_t n = 1;
+  while (true) {
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < n; i++) op(i);
+    uint64_t elapsed = now_ns() - start;
+    if (elapsed >= 50000000 || n >= (1u << 30)) {
+      *calls = n;
+      return (double) elapsed / n;
+    }
+    n *= (elapsed < 5000000) ? 10 : 2;
+  }
+}
+
+static bool selected(const char *name) {
+  return filter == NULL || strstr(name, filter) != NULL;
+}
+
+// Time a drawing primitive.  The pixel count is the area one call covers,
+// measured by drawing it once in white on a clear screen.
+static void bench(const char *name, void (*op)(uint32_t)) {
+  if (!selected(name)) return;
+
+  display.clearDisplay();
+  op(0);
+  uint32_t pixels = litPixels();
+
+  uint32_t calls;
+  double ns = timeOp(op, &calls);
+  printf("%-28s %10.1f ns/op %8.2f Mpx/s %6u px/op\n",
+         name, ns, pixels * 1000.0 / ns, (unsigned) pixels);
+}
+
+// Time a flush; setup runs before each display() and is timed with it
+static void benchFlush(const char *name, void (*setup)(uint32_t)) {
+  if (!selected(name)) return;
+
+  display.clearDisplay();
+  display.display();
+
+  bus.clear();
+  setup(0);
+  display.display();
+  uint32_t tx = bus.transactions;
+  uint32_t bytes = bus.commandBytes + bus.dataBytes;
+
+  uint32_t calls;
+  double ns = timeOp(setup, &calls);
+  printf("%-28s %10.1f ns/op %8u B/frame %4u writes/frame\n",
+         name, ns, (unsigned) bytes, (unsigned) tx);
+}
+
+static uint16_t color(uint32_t i) { return (i & 1) ? BLACK : WHITE; }
+
+static void opLine(uint32_t i)         { display.drawLine(3, 5, 120, 58, color(i)); }
+static void opLineSteep(uint32_t i)    { display.drawLine(10, 0, 30, 63, color(i)); }
+static void opLineClipped(uint32_t i)  { display.drawLine(-900, -380, 1000, 450, color(i)); }
+static void opHLine(uint32_t i)        { display.drawFastHLine(2, 21, 120, color(i)); }
+static void opVLine(uint32_t i)        { display.drawFastVLine(40, 3, 57, color(i)); }
+static void opRect(uint32_t i)         { display.drawRect(10, 5, 100, 50, color(i)); }
+static void opFillRect(uint32_t i)     { display.fillRect(10, 5, 100, 50, color(i)); }
+static void opFillScreen(uint32_t i)   { display.fillScreen(color(i)); }
+static void opCircle(uint32_t i)       { display.drawCircle(64, 32, 30, color(i)); }
+static void opFillCircle(uint32_t i)   { display.fillCircle(64, 32, 30, color(i)); }
+static void opTriangle(uint32_t i)     { display.drawTriangle(5, 60, 64, 2, 122, 50, color(i)); }
+static void opFillTriangle(uint32_t i) { display.fillTriangle(5, 60, 64, 2, 122, 50, color(i)); }
+static void opRoundRect(uint32_t i)    { display.drawRoundRect(8, 4, 112, 56, 12, color(i)); }
+static void opFillRoundRect(uint32_t i) { display.fillRoundRect(8, 4, 112, 56, 12, color(i)); }
+static void opBitmap(uint32_t i)       { display.drawBitmap(37, 21, logo16_glcd_bmp, 16, 16, color(i)); }
+static void opBitmapBg(uint32_t i)     { display.drawBitmap(37, 21, logo16_glcd_bmp, 16, 16, color(i), color(i + 1)); }
+
+static void opChar(uint32_t i) {
+  display.drawChar(8, 8, 'A' + (i & 15), color(i), color(i), textSize);
+}
+
+static void opCharBg(uint32_t i) {
+  display.drawChar(8, 8, 'A' + (i & 15), WHITE, BLACK, textSize);
+}
+
+static void opPrint(uint32_t i) {
+  display.setCursor(0, 0);
+  display.print("Hello 42");
+}
+
+static void opPrintLong(uint32_t i)  { display.setCursor(0, 0); display.print(123456789L + (long) i); }
+static void opPrintFloat(uint32_t i) { display.setCursor(0, 0); display.print(3.141592); }
+static void opPrintFixed(uint32_t i) { display.setCursor(0, 0); display.printFixed(-2153, 2, 1, 6); }
+
+static void flushFull(uint32_t i)   { display.invalidate(); display.display(); }
+static void flushPixel(uint32_t i)  { display.drawPixel(i & 127, 20, color(i >> 7)); display.display(); }
+static void flushText(uint32_t i)   { display.setCursor(0, 0); display.print(i); display.display(); }
+static void flushRegion(uint32_t i) { display.displayRegion(40, 16, 30, 16); }
+static void flushNone(uint32_t i)   { display.display(); }
+
+// A small UI scene, for comparing strip rendering with drawing into the
+// framebuffer and flushing it
+static void recordScene(void) {
+  scene.clear();
+  scene.drawRoundRect(0, 0, 128, 64, 6, WHITE);
+  scene.drawText(6, 4, "Status", 2, WHITE, BLACK);
+  scene.drawFastHLine(4, 22, 120, WHITE);
+  scene.fillRect(6, 28, 80, 8, WHITE);
+  scene.drawRect(6, 28, 116, 8, WHITE);
+  scene.drawText(6, 42, "temp 21.5 C", 1, WHITE, BLACK);
+  scene.fillCircle(108, 50, 8, WHITE);
+  scene.drawBitmap(88, 42, logo16_glcd_bmp, 16, 16, WHITE);
+}
+
+static void sceneFramebuffer(uint32_t i) { display.clearDisplay(); scene.replay(display); display.display(); }
+static void sceneStrip(uint32_t i)       { strip.render(scene); }
+
+static void sceneRedraw(uint32_t i) {
+  scene.invalidate(6, 42, 66, 8);
+  scene.redraw(display);
+  display.displayRegion(6, 42, 66, 8);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) filter = argv[1];
+
+  display.init();
+  display.setTextWrap(false);
+
+  bench("drawLine", opLine);
+  bench("drawLine steep", opLineSteep);
+  bench("drawLine clipped", opLineClipped);
+  bench("drawFastHLine", opHLine);
+  bench("drawFastVLine", opVLine);
+  bench("drawRect", opRect);
+  bench("fillRect", opFillRect);
+  bench("fillScreen", opFillScreen);
+  bench("drawCircle", opCircle);
+  bench("fillCircle", opFillCircle);
+  bench("drawTriangle", opTriangle);
+  bench("fillTriangle", opFillTriangle);
+  bench("drawRoundRect", opRoundRect);
+  bench("fillRoundRect", opFillRoundRect);
+  bench("drawBitmap", opBitmap);
+  bench("drawBitmap bg", opBitmapBg);
+
+  char name[40];
+  for (uint8_t rotation = 0; rotation < 4; rotation++) {
+    display.setRotation(rotation);
+    for (uint8_t size = 1; size <= 4; size++) {
+      textSize = size;
+      display.setTextSize(size);
+      display.setTextColor(WHITE);
+      snprintf(name, sizeof(name), "drawChar r%u s%u", rotation, size);
+      bench(name, opChar);
+      snprintf(name, sizeof(name), "drawChar bg r%u s%u", rotation, size);
+      bench(name, opCharBg);
+      snprintf(name, sizeof(name), "print r%u s%u", rotation, size);
+      bench(name, opPrint);
+    }
+  }
+  display.setRotation(0);
+  display.setTextSize(1);
+  display.setTextColor(WHITE, BLACK);
+
+  bench("print long", opPrintLong);
+  bench("print double", opPrintFloat);
+  bench("printFixed", opPrintFixed);
+
+  benchFlush("display full frame", flushFull);
+  benchFlush("display one pixel", flushPixel);
+  benchFlush("display counter text", flushText);
+  benchFlush("displayRegion 30x16", flushRegion);
+  benchFlush("display nothing dirty", flushNone);
+
+  recordScene();
+  benchFlush("scene framebuffer", sceneFramebuffer);
+  benchFlush("scene strip", sceneStrip);
+  benchFlush("scene redraw 66x8", sceneRedraw);
+
+  return 0;
+}
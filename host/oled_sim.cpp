@@ -0,0 +1,825 @@
+// Host simulator for the OLED driver
+//
+// Runs Adafruit_GFX + Adafruit_SSD1306 against SSD1306_Simulator, checks
+// after every display() that the emulated panel RAM matches the driver's
+// buffer, and writes each frame as a PNG (and PBM) into the output
+// directory.  It also checks the text print() and printFixed() produce,
+// random scenes against Adafruit_GFX's per-pixel drawing, and strip
+// rendering and redraw() of display lists against a framebuffer.
+// Build with "make host", run as "host/oled_sim [outdir]".
+
+#include "Adafruit_SSD1306.h"
+#include "SSD1306_Simulator.h"
+#include "SSD1306_Strip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static SSD1306_Simulator panel;
+static Adafruit_SSD1306 display(panel);
+static const char *outdir = ".";
+static int frames = 0, failures = 0;
+
+static const unsigned char logo16_glcd_bmp[] =
+{ 0b00000000, 0b11000000,
+  0b00000001, 0b11000000,
+  0b00000001, 0b11000000,
+  0b00000011, 0b11100000,
+  0b11110011, 0b11100000,
+  0b11111110, 0b11111000,
+  0b01111110, 0b11111111,
+  0b00110011, 0b10011111,
+  0b00011111, 0b11111100,
+  0b00001101, 0b01110000,
+  0b00011011, 0b10100000,
+  0b00111111, 0b11100000,
+  0b00111111, 0b11110000,
+  0b01111100, 0b11110000,
+  0b01110000, 0b01110000,
+  0b00000000, 0b00110000 };
+
+// Send the frame, check the panel got it, and dump it
+static void frame(const char *name) {
+  uint32_t tx = panel.transactions, cmd = panel.commandBytes, data = panel.dataBytes;
+
+  display.display();
+
+  bool match = memcmp(panel.ram, display.getBuffer(), sizeof(panel.ram)) == 0;
+  if (!match) failures++;
+
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%02d_%s.png", outdir, frames, name);
+  panel.writePNG(path, 4);
+  snprintf(path, sizeof(path), "%s/%02d_%s.pbm", outdir, frames, name);
+  panel.writePBM(path);
+  frames++;
+
+  printf("%-14s %4u writes %5u command bytes %5u data bytes  %s\n", name,
+         (unsigned) (panel.transactions - tx), (unsigned) (panel.commandBytes - cmd),
+         (unsigned) (panel.dataBytes - data), match ? "ok" : "MISMATCH");
+}
+
+// Collects the text printed instead of drawing it
+class TextCapture : public Adafruit_GFX {
+ public:
+  char text[64];
+  uint8_t length;
+
+  TextCapture() : Adafruit_GFX(128, 64), length(0) { text[0] = 0; }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {}
+  uint8_t write(uint8_t c) {
+    if (length < sizeof(text) - 1) text[length++] = c;
+    text[length] = 0;
+    return 1;
+  }
+  using Adafruit_GFX::write;
+};
+
+static TextCapture capture;
+
+static void expect(const char *want, const char *what) {
+  if (strcmp(capture.text, want) != 0) {
+    if (failures < 10) printf("%s: got \"%s\", want \"%s\"\n", what, capture.text, want);
+    failures++;
+  }
+  capture.length = 0;
+  capture.text[0] = 0;
+}
+
+// print(double) as Arduino's Print does it: add half of the last digit,
+// then take the digits by truncation
+static void referenceFloat(char *out, double number, uint8_t digits) {
+  if (number < 0.0) {
+    *out++ = '-';
+    number = -number;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) rounding /= 10.0;
+  number += rounding;
+  unsigned long int_part = (unsigned long) number;
+  double remainder = number - (double) int_part;
+  out += sprintf(out, "%lu", int_part);
+  if (digits > 0) *out++ = '.';
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    int toPrint = int(remainder);
+    *out++ = '0' + toPrint;
+    remainder -= toPrint;
+  }
+  *out = 0;
+}
+
+// print() keeps Arduino's digits, and printFixed() rounds half up with no "-0"
+static void checkNumbers() {
+  static const struct { double value; uint8_t digits; const char *text; } floats[] = {
+    { 3.141592, 2, "3.14" }, { 1.999, 2, "2.00" }, { 1109.25, 1, "1109.2" },
+    { 671.875, 2, "671.87" }, { -18.3075, 3, "-18.307" }, { 0.0, 0, "0" }
+  };
+  static const struct {
+    int32_t value; uint8_t scale, digits, width; char pad; const char *text;
+  } fixed[] = {
+    { 2153, 2, 1, 6, ' ', "  21.5" }, { -7, 0, 0, 4, '0', "-007" },
+    { -4, 3, 0, 0, ' ', "0" }, { -4, 3, 2, 0, ' ', "0.00" }, { -5, 1, 0, 3, '0', "-01" },
+    { 7, 0, 2, 0, ' ', "7.00" }, { -2147483647 - 1, 0, 0, 0, ' ', "-2147483648" }
+  };
+  char want[64], what[64];
+  unsigned checks = 0;
+
+  for (uint8_t i = 0; i < sizeof(floats) / sizeof(floats[0]); i++, checks++) {
+    capture.print(floats[i].value, floats[i].digits);
+    snprintf(what, sizeof(what), "print(%g, %u)", floats[i].value, floats[i].digits);
+    expect(floats[i].text, what);
+  }
+  for (uint8_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++, checks++) {
+    capture.printFixed(fixed[i].value, fixed[i].scale, fixed[i].digits,
+                       fixed[i].width, fixed[i].pad);
+    snprintf(what, sizeof(what), "printFixed(%ld, %u, %u)", (long) fixed[i].value,
+             fixed[i].scale, fixed[i].digits);
+    expect(fixed[i].text, what);
+  }
+
+  // binary fractions land on and near the halfway points, where rounding
+  // the scaled value instead would show
+  srand(1);
+  for (uint32_t i = 0; i < 200000; i++, checks++) {
+    uint8_t digits = rand() % 5;
+    double value = (rand() % 2000000 - 1000000) / 8.0 / (1 << (rand() % 8));
+    capture.print(value, digits);
+    referenceFloat(want, value, digits);
+    snprintf(what, sizeof(what), "print(%.17g, %u)", value, digits);
+    expect(want, what);
+  }
+
+  printf("%-14s %u checks\n", "numbers", checks);
+}
+
+// Does the simulated RAM hold a frame of w columns by pages, placed at
+// column offset on the controller?
+static bool ramMatches(const SSD1306_Simulator &sim, const uint8_t *frame,
+                       int16_t w, uint8_t pages, uint8_t offset) {
+  for (uint8_t page = 0; page < pages; page++) {
+    if (memcmp(&sim.ram[page][offset], frame + page * w, w) != 0) return false;
+  }
+  return true;
+}
+
+// Adafruit_GFX's own per-pixel drawing into a buffer laid out like the
+// panel's, to check the panel's fast paths against.  As in the original
+// driver, a span of no pixels draws nothing.
+template <int16_t W, int16_t H>
+class PixelCanvas : public Adafruit_GFX {
+ public:
+  uint8_t buffer[W * H / 8];
+
+  PixelCanvas() : Adafruit_GFX(W, H) {}
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x < 0 || x >= width() || y < 0 || y >= height()) return;
+    int16_t t = x;
+    switch (getRotation()) {
+    case 1: x = W - 1 - y; y = t; break;
+    case 2: x = W - 1 - x; y = H - 1 - y; break;
+    case 3: x = y; y = H - 1 - t; break;
+    }
+    uint8_t *b = &buffer[(y / 8) * W + x];
+    uint8_t bit = 1 << (y & 7);
+    switch (color) {
+    case WHITE:   *b |= bit; break;
+    case BLACK:   *b &= ~bit; break;
+    case INVERSE: *b ^= bit; break;
+    }
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color);
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color);
+  }
+};
+
+// A small generator of our own, so the panel and the reference can be
+// handed the same scene
+static uint32_t seed;
+
+static int32_t pick(int32_t lo, int32_t hi) {
+  seed = seed * 1664525 + 1013904223;
+  return lo + (int32_t) ((seed >> 8) % (uint32_t) (hi - lo + 1));
+}
+
+// A coordinate: mostly on or around the screen, sometimes far off it or
+// right at the int16 limits
+static int16_t coord(void) {
+  switch (pick(0, 9)) {
+  case 0:  return pick(-32768, -32700);
+  case 1:  return pick(32700, 32767);
+  case 2:  return pick(-16000, 16000);
+  default: return pick(-40, 170);
+  }
+}
+
+// v moved so that v + lo and v + hi still fit: Adafruit_GFX works out the
+// far edges of a shape in 16 bits
+static int16_t room(int16_t v, int32_t lo, int32_t hi) {
+  if (v + hi > 32767) return 32767 - hi;
+  if (v + lo < -32768) return -32768 - lo;
+  return v;
+}
+
+// A line end: a line may reach far off screen, but no further than its
+// length still fits in 16 bits
+static int16_t lineEnd(void) {
+  return pick(0, 3) ? pick(-40, 170) : pick(-16000, 16000);
+}
+
+static void drawScene(Adafruit_GFX &g) {
+  for (uint8_t i = 0; i < 24; i++) {
+    int16_t x = room(coord(), -200, 200), y = room(coord(), -200, 200);
+    int16_t w = pick(-4, 90), h = pick(-4, 70), r = pick(0, 20);
+    uint16_t color = pick(0, 2), bg = pick(0, 2);
+    int16_t cx, cy, cr;
+
+    switch (pick(0, 16)) {
+    case 0:  g.drawPixel(x, y, color); break;
+    case 1:  g.drawFastHLine(x, y, w, color); break;
+    case 2:  g.drawFastVLine(x, y, h, color); break;
+    case 3:  g.drawLine(lineEnd(), lineEnd(), lineEnd(), lineEnd(), color); break;
+    case 4:  g.drawRect(x, y, w, h, color); break;
+    case 5:  g.fillRect(x, y, w, h, color); break;
+    case 6:
+      cr = pick(0, 3) ? pick(0, 50) : pick(0, 2000);
+      cx = room(coord(), -cr, cr);
+      cy = room(coord(), -cr, cr);
+      g.drawCircle(cx, cy, cr, color);
+      break;
+    case 7:  g.fillCircle(x, y, pick(0, 50), color); break;
+    case 8:
+      g.drawTriangle(lineEnd(), lineEnd(), lineEnd(), lineEnd(), lineEnd(), lineEnd(), color);
+      break;
+    case 9:
+      g.fillTriangle(pick(-300, 430), pick(-300, 360), pick(-300, 430), pick(-300, 360),
+                     pick(-300, 430), pick(-300, 360), color);
+      break;
+    case 10: g.drawRoundRect(x, y, w, h, r, color); break;
+    case 11: g.fillRoundRect(x, y, w, h, r, color); break;
+    case 12: g.drawBitmap(x, y, logo16_glcd_bmp, pick(0, 16), pick(0, 16), color); break;
+    case 13: g.drawBitmap(x, y, logo16_glcd_bmp, pick(0, 16), pick(0, 16), color, bg); break;
+    case 14:
+      // a background the same as the colour means none
+      g.drawChar(x, y, pick(0, 254), color, pick(0, 1) ? color : bg, pick(1, 5));
+      break;
+    case 15:
+      g.setCursor(pick(-40, 170), pick(-40, 100));
+      g.setTextSize(pick(1, 5));
+      if (pick(0, 1)) g.setTextColor(color);
+      else g.setTextColor(color, bg);
+      g.setTextWrap(pick(0, 1));
+      for (uint8_t n = pick(1, 12); n > 0; n--) g.write(pick(0, 9) ? pick(32, 126) : '\n');
+      break;
+    case 16:
+      if (pick(0, 9) == 0) g.fillScreen(color);
+      break;
+    }
+  }
+}
+
+// Random scenes drawn on the panel and by Adafruit_GFX's per-pixel code
+// must come out the same in every rotation, and reach the panel intact
+template <int16_t W, int16_t H, uint8_t COMPINS>
+static void checkPrimitives(const char *name, uint16_t scenes) {
+  SSD1306_Simulator sim;
+  Adafruit_SSD1306_Panel<W, H, COMPINS> oled(sim);
+  PixelCanvas<W, H> reference;
+  uint16_t bad = 0;
+  static uint8_t pixels[SSD1306_SIM_WIDTH * SSD1306_SIM_HEIGHT];
+  const int16_t offset = (SSD1306_SIM_WIDTH - W) / 2;
+
+  oled.init();
+  if (sim.multiplex != H - 1 || sim.comPins != COMPINS) {
+    printf("%s: multiplex %u, COM pins 0x%02X\n", name, sim.multiplex, sim.comPins);
+    bad++;
+  }
+  for (uint16_t i = 0; i < scenes; i++) {
+    // a random background, so BLACK and INVERSE show
+    uint8_t *buffer = oled.getBuffer();
+    seed = i;
+    for (uint16_t j = 0; j < sizeof(reference.buffer); j++) buffer[j] = pick(0, 255);
+    memcpy(reference.buffer, buffer, sizeof(reference.buffer));
+    oled.invalidate();
+
+    oled.setRotation(i & 3);
+    reference.setRotation(i & 3);
+    seed = i;
+    drawScene(oled);
+    seed = i;
+    drawScene(reference);
+    oled.display();
+
+    if (memcmp(oled.getBuffer(), reference.buffer, sizeof(reference.buffer)) != 0 ||
+        !ramMatches(sim, oled.getBuffer(), W, H / 8, offset)) {
+      if (bad++ < 5) printf("%s: scene %u differs\n", name, i);
+      continue;
+    }
+
+    // and on the glass, the panel's columns centred in the controller's 128
+    sim.render(pixels);
+    bool ok = true;
+    for (int16_t y = 0; y < H && ok; y++) {
+      for (int16_t x = 0; x < W; x++) {
+        bool lit = (reference.buffer[(y / 8) * W + x] >> (y & 7)) & 1;
+        if (pixels[y * SSD1306_SIM_WIDTH + offset + x] != lit) { ok = false; break; }
+      }
+    }
+    if (!ok && bad++ < 5) printf("%s: scene %u differs on the glass\n", name, i);
+  }
+  failures += bad;
+  printf("%-14s %u scenes\n", name, scenes);
+}
+
+static void recordScene(SSD1306_DisplayList &list) {
+  static const char *texts[] = { "Hello", "42", "a\nb", "~!@#$%" };
+
+  for (uint8_t i = 0; i < 16; i++) {
+    int16_t x = room(coord(), -200, 200), y = room(coord(), -200, 200);
+    int16_t w = pick(-4, 90), h = pick(-4, 70), r = pick(-10, 40);
+    uint16_t color = pick(0, 2), bg = pick(0, 2);
+
+    // zero and negative sizes are common: they still draw, and the
+    // recorded box has to cover what they draw
+    if (pick(0, 3) == 0) w = pick(-1, 0);
+    if (pick(0, 3) == 0) h = pick(-1, 0);
+
+    switch (pick(0, 14)) {
+    case 0:  list.drawPixel(x, y, color); break;
+    case 1:  list.drawFastHLine(x, y, w, color); break;
+    case 2:  list.drawFastVLine(x, y, h, color); break;
+    case 3:  list.drawLine(lineEnd(), lineEnd(), lineEnd(), lineEnd(), color); break;
+    case 4:  list.drawRect(x, y, w, h, color); break;
+    case 5:  list.fillRect(x, y, w, h, color); break;
+    case 6:  list.drawCircle(x, y, r, color); break;
+    case 7:  list.fillCircle(x, y, r, color); break;
+    case 8:
+      list.drawTriangle(lineEnd(), lineEnd(), lineEnd(), lineEnd(), lineEnd(), lineEnd(), color);
+      break;
+    case 9:
+      list.fillTriangle(pick(-300, 430), pick(-300, 360), pick(-300, 430), pick(-300, 360),
+                        pick(-300, 430), pick(-300, 360), color);
+      break;
+    case 10: list.drawRoundRect(x, y, w, h, r, color); break;
+    case 11: list.fillRoundRect(x, y, w, h, r, color); break;
+    case 12: list.drawBitmap(x, y, logo16_glcd_bmp, pick(0, 16), pick(0, 16), color); break;
+    case 13: list.drawBitmap(x, y, logo16_glcd_bmp, pick(0, 16), pick(0, 16), color, bg); break;
+    case 14:
+      list.drawText(pick(-40, 170), pick(-40, 100), texts[pick(0, 3)], pick(1, 5), color,
+                    pick(0, 1) ? color : bg);
+      break;
+    }
+  }
+}
+
+// A list rendered a page at a time by the strip driver must put the same
+// frame on the panel as replaying it into a framebuffer, in every
+// rotation; and redrawing the invalidated part of a spoilt frame must
+// restore it
+static void checkDisplayList(uint16_t scenes) {
+  static uint8_t storage[2048];
+  SSD1306_DisplayList list(storage, sizeof(storage));
+  SSD1306_Simulator framed, striped;
+  Adafruit_SSD1306 oled(framed);
+  Adafruit_SSD1306_Strip128x64 strip(striped);
+  uint8_t replayed[Adafruit_SSD1306::BUFSIZE];
+  uint16_t bad = 0;
+
+  oled.init();
+  strip.init();
+  for (uint16_t i = 0; i < scenes; i++) {
+    list.clear();
+    seed = i;
+    recordScene(list);
+
+    oled.setRotation(i & 3);
+    strip.setRotation(i & 3);
+    oled.clearDisplay();
+    list.replay(oled);
+    oled.display();
+    strip.render(list);
+    memcpy(replayed, oled.getBuffer(), sizeof(replayed));
+
+    // spoil two rectangles, then repair them from the list
+    for (uint8_t n = 0; n < 2; n++) {
+      int16_t x = pick(-20, 140), y = pick(-20, 80), w = pick(1, 60), h = pick(1, 40);
+      oled.fillRect(x, y, w, h, INVERSE);
+      list.invalidate(x, y, w, h);
+    }
+    list.redraw(oled);
+
+    if (memcmp(framed.ram, striped.ram, sizeof(framed.ram)) != 0 ||
+        memcmp(oled.getBuffer(), replayed, sizeof(replayed)) != 0) {
+      if (bad++ < 5) printf("display list: scene %u differs\n", i);
+    }
+  }
+  failures += bad;
+  printf("%-14s %u scenes\n", "display list", scenes);
+}
+
+// Fill the buffer with noise and mark all of it dirty
+static void scramble(Adafruit_SSD1306 &oled) {
+  uint8_t *buffer = oled.getBuffer();
+  for (uint16_t i = 0; i < Adafruit_SSD1306::BUFSIZE; i++) buffer[i] = pick(0, 255);
+  oled.invalidate();
+}
+
+// Does the panel show frame inside columns c0..c1 of pages p0..p1, and
+// old everywhere else?
+static bool windowMatches(const SSD1306_Simulator &sim, const uint8_t *frame, const uint8_t *old,
+                          int16_t c0, int16_t c1, int16_t p0, int16_t p1) {
+  for (int16_t page = 0; page < SSD1306_SIM_PAGES; page++) {
+    for (int16_t col = 0; col < SSD1306_SIM_WIDTH; col++) {
+      bool inside = page >= p0 && page <= p1 && col >= c0 && col <= c1;
+      uint8_t want = (inside ? frame : old)[page * SSD1306_SIM_WIDTH + col];
+      if (sim.ram[page][col] != want) return false;
+    }
+  }
+  return true;
+}
+
+// displayRegion() and displayPages() send exactly the window asked for,
+// whole pages tall, and clean the dirty ranges that window covers
+static void checkRegions(uint16_t regions) {
+  SSD1306_Simulator sim;
+  Adafruit_SSD1306 oled(sim);
+  PixelCanvas<128, 64> box;
+  uint8_t old[Adafruit_SSD1306::BUFSIZE];
+  uint16_t bad = 0;
+
+  oled.init();
+  seed = 12;
+  for (uint16_t i = 0; i < regions; i++) {
+    int16_t x = pick(-20, 140), y = pick(-20, 80), w = pick(-2, 70), h = pick(-2, 50);
+    oled.setRotation(i & 3);
+    scramble(oled);
+    oled.display();
+    memcpy(old, oled.getBuffer(), sizeof(old));
+
+    // the panel window: the page and column span of the region's pixels
+    box.setRotation(i & 3);
+    memset(box.buffer, 0, sizeof(box.buffer));
+    box.fillRect(x, y, w, h, WHITE);
+    int16_t c0 = SSD1306_SIM_WIDTH, c1 = -1, p0 = SSD1306_SIM_PAGES, p1 = -1;
+    for (int16_t page = 0; page < SSD1306_SIM_PAGES; page++) {
+      for (int16_t col = 0; col < SSD1306_SIM_WIDTH; col++) {
+        if (box.buffer[page * SSD1306_SIM_WIDTH + col] == 0) continue;
+        if (col < c0) c0 = col;
+        if (col > c1) c1 = col;
+        if (page < p0) p0 = page;
+        if (page > p1) p1 = page;
+      }
+    }
+    uint32_t window = (c1 < c0) ? 0 : (c1 - c0 + 1) * (p1 - p0 + 1);
+
+    scramble(oled);
+    uint32_t data = sim.dataBytes;
+    oled.displayRegion(x, y, w, h);
+    bool ok = sim.dataBytes - data == window &&
+              windowMatches(sim, oled.getBuffer(), old, c0, c1, p0, p1);
+
+    // drawing only inside the region leaves nothing for display() to send
+    oled.display();
+    oled.fillRect(x, y, w, h, INVERSE);
+    oled.displayRegion(x, y, w, h);
+    data = sim.dataBytes;
+    oled.display();
+    ok = ok && sim.dataBytes == data && memcmp(sim.ram, oled.getBuffer(), sizeof(sim.ram)) == 0;
+
+    if (!ok && bad++ < 5) {
+      printf("regions: rotation %u, %d,%d %dx%d\n", i & 3, x, y, w, h);
+    }
+  }
+
+  // a page aligned 30x16 area is two pages of 30 columns
+  oled.setRotation(0);
+  scramble(oled);
+  uint32_t data = sim.dataBytes;
+  oled.displayRegion(10, 8, 30, 16);
+  if (sim.dataBytes - data != 60) {
+    printf("regions: 30x16 took %u bytes\n", (unsigned) (sim.dataBytes - data));
+    bad++;
+  }
+
+  // whole pages, and then display() only sends the rest
+  for (uint8_t first = 0; first < SSD1306_SIM_PAGES; first++) {
+    uint8_t last = pick(first, SSD1306_SIM_PAGES + 1);
+    oled.display();
+    memcpy(old, oled.getBuffer(), sizeof(old));
+    scramble(oled);
+    data = sim.dataBytes;
+    oled.displayPages(first, last);
+    if (last >= SSD1306_SIM_PAGES) last = SSD1306_SIM_PAGES - 1;
+    uint32_t sent = sim.dataBytes - data;
+    bool ok = sent == (uint32_t) SSD1306_SIM_WIDTH * (last - first + 1) &&
+              windowMatches(sim, oled.getBuffer(), old, 0, SSD1306_SIM_WIDTH - 1, first, last);
+    data = sim.dataBytes;
+    oled.display();
+    ok = ok && sim.dataBytes - data == Adafruit_SSD1306::BUFSIZE - sent;
+    if (!ok && bad++ < 5) printf("regions: pages %u..%u\n", first, last);
+  }
+
+  failures += bad;
+  printf("%-14s %u regions\n", "regions", regions);
+}
+
+// Redraw parts of the screen with what is already there
+static void redrawSame(Adafruit_SSD1306 &oled) {
+  for (uint8_t n = pick(1, 4); n > 0; n--) {
+    int16_t x = pick(0, 127), y = pick(0, 63), w = pick(1, 128 - x), h = pick(1, 64 - y);
+    oled.fillRect(x, y, w, h, INVERSE);
+    oled.fillRect(x, y, w, h, INVERSE);
+  }
+}
+
+// With diff mode on, redrawing what the panel already shows sends nothing,
+// and a few changed bytes go out without the rest of their dirty pages
+static void checkDiffMode(uint16_t rounds) {
+  SSD1306_Simulator sim;
+  Adafruit_SSD1306 oled(sim);
+  uint8_t old[Adafruit_SSD1306::BUFSIZE];
+  uint16_t bad = 0;
+
+  oled.init();
+  if (!oled.setDiffMode(true)) {
+    printf("diff mode: no shadow\n");
+    failures++;
+    return;
+  }
+  seed = 5;
+  for (uint16_t i = 0; i < rounds; i++) {
+    scramble(oled);
+    oled.display();
+    memcpy(old, oled.getBuffer(), sizeof(old));
+
+    // the same frame again, with dirty ranges starting and ending
+    // anywhere in a word
+    redrawSame(oled);
+    uint32_t data = sim.dataBytes;
+    oled.display();
+    bool ok = sim.dataBytes == data;
+
+    // flip a few bytes here and there, in and around dirty ranges, some
+    // close together and some far apart
+    redrawSame(oled);
+    for (uint8_t n = pick(1, 10); n > 0; n--) {
+      oled.drawFastVLine(pick(0, SSD1306_SIM_WIDTH - 1), pick(0, SSD1306_SIM_PAGES - 1) * 8, 8,
+                         INVERSE);
+    }
+    // what has to go out: at least every changed byte, at most from the
+    // first to the last change in each page, plus what merging pages into
+    // one window saves on window setup
+    uint32_t changed = 0, spans = 0;
+    for (uint8_t page = 0; page < SSD1306_SIM_PAGES; page++) {
+      int16_t first = -1, last = -1;
+      for (int16_t col = 0; col < SSD1306_SIM_WIDTH; col++) {
+        uint16_t j = page * SSD1306_SIM_WIDTH + col;
+        if (oled.getBuffer()[j] == old[j]) continue;
+        changed++;
+        if (first < 0) first = col;
+        last = col;
+      }
+      if (first >= 0) spans += last - first + 1 + SSD1306_WINDOW_COST;
+    }
+    data = sim.dataBytes;
+    oled.display();
+    uint32_t sent = sim.dataBytes - data;
+    ok = ok && sent >= changed && sent <= spans &&
+         memcmp(sim.ram, oled.getBuffer(), sizeof(sim.ram)) == 0;
+
+    if (!ok && bad++ < 5) printf("diff mode: round %u\n", i);
+  }
+
+  // two changed bytes in one page go out as one run while the gap
+  // between them costs less than a second window
+  for (uint8_t gap = 0; gap <= SSD1306_WINDOW_COST + 3; gap++) {
+    oled.display();
+    oled.drawFastVLine(10, 24, 8, INVERSE);
+    oled.drawFastVLine(11 + gap, 24, 8, INVERSE);
+    uint32_t data = sim.dataBytes;
+    oled.display();
+    uint32_t want = (gap > SSD1306_WINDOW_COST) ? 2 : gap + 2;
+    if (sim.dataBytes - data != want) {
+      printf("diff mode: gap %u sent %u bytes\n", gap, (unsigned) (sim.dataBytes - data));
+      bad++;
+    }
+  }
+  failures += bad;
+  printf("%-14s %u rounds\n", "diff mode", rounds);
+}
+
+// Does the glass show what canvas holds, unrotated?
+static bool glassMatches(const SSD1306_Simulator &sim, const PixelCanvas<128, 64> &canvas) {
+  static uint8_t pixels[SSD1306_SIM_WIDTH * SSD1306_SIM_HEIGHT];
+  sim.render(pixels);
+  for (int16_t y = 0; y < SSD1306_SIM_HEIGHT; y++) {
+    for (int16_t x = 0; x < SSD1306_SIM_WIDTH; x++) {
+      bool lit = (canvas.buffer[(y / 8) * SSD1306_SIM_WIDTH + x] >> (y & 7)) & 1;
+      if (pixels[y * SSD1306_SIM_WIDTH + x] != lit) return false;
+    }
+  }
+  return true;
+}
+
+// Console mode keeps the last screenful of lines on the glass as the log
+// runs past the bottom, and setConsole(false) leaves them where they are
+// with the buffer back in screen order
+static void checkConsole(uint16_t rounds) {
+  static char lines[64][48];
+  SSD1306_Simulator sim;
+  Adafruit_SSD1306 oled(sim);
+  PixelCanvas<128, 64> screen;
+  uint16_t bad = 0;
+
+  oled.init();
+  seed = 10;
+  for (uint16_t i = 0; i < rounds; i++) {
+    uint8_t size = pick(1, 2);
+    uint8_t perLine = (128 - 6 * size) / (6 * size) + 1;
+    uint8_t rows = 64 / (8 * size);
+    uint8_t count = 0;
+    bool ok = true;
+
+    oled.setConsole(true);
+    oled.setTextSize(size);
+    oled.setTextColor(WHITE);
+    oled.setTextWrap(true);
+
+    for (uint8_t n = pick(1, 40); n > 0; n--) {
+      // a line of text, possibly wrapping onto the next ones
+      char text[48];
+      uint8_t len = pick(0, 2 * perLine);
+      for (uint8_t j = 0; j < len; j++) text[j] = pick(33, 126);
+      text[len] = 0;
+      oled.print(text);
+      oled.print('\n');
+      oled.display();
+      for (uint8_t j = 0; j == 0 || j < len; j += perLine) {
+        snprintf(lines[count++ % 64], sizeof(lines[0]), "%.*s", perLine, text + j);
+      }
+
+      // what a plain text screen would show: the last rows lines
+      memset(screen.buffer, 0, sizeof(screen.buffer));
+      screen.setCursor(0, 0);
+      screen.setTextSize(size);
+      screen.setTextColor(WHITE);
+      screen.setTextWrap(false);
+      uint8_t first = (count > rows) ? count - rows : 0;
+      for (uint8_t j = first; j < count; j++) {
+        screen.print(lines[j % 64]);
+        screen.print('\n');
+      }
+      ok = ok && glassMatches(sim, screen);
+    }
+
+    oled.setConsole(false);
+    oled.display();
+    ok = ok && glassMatches(sim, screen) &&
+         memcmp(oled.getBuffer(), screen.buffer, sizeof(screen.buffer)) == 0;
+    if (!ok && bad++ < 5) printf("console: round %u\n", i);
+  }
+  failures += bad;
+  printf("%-14s %u rounds\n", "console", rounds);
+}
+
+// The clock the driver times scrolls with on the host
+static uint32_t nowMs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// stopscroll(true) leaves the image where the panel scrolled it to, with
+// the buffer rotated to match
+static void checkScrollFollow(uint16_t rounds) {
+  static uint8_t scrolled[SSD1306_SIM_WIDTH * SSD1306_SIM_HEIGHT];
+  static uint8_t stopped[SSD1306_SIM_WIDTH * SSD1306_SIM_HEIGHT];
+  SSD1306_Simulator sim;
+  Adafruit_SSD1306 oled(sim);
+  uint16_t bad = 0, checked = 0;
+
+  oled.init();
+  // 10 steps a millisecond at the fastest interval, 2 frames a step, so a
+  // few milliseconds scroll past a full turn
+  oled.setFramePeriod(50);
+  seed = 11;
+  for (uint16_t i = 0; i < rounds; i++) {
+    uint8_t first = pick(0, 7), last = pick(first, 7);
+    uint32_t wait = pick(0, 30);
+    scramble(oled);
+    oled.display();
+    if (pick(0, 1)) oled.startscrollright(first, last, 7);
+    else oled.startscrollleft(first, last, 7);
+
+    // let the scroll run, then catch a fresh millisecond so the driver's
+    // estimate and the simulator see the same time
+    uint32_t start = nowMs();
+    while (nowMs() - start < wait) {}
+    uint32_t tick = nowMs();
+    while (nowMs() == tick) {}
+    tick = nowMs();
+    sim.advanceFrames(oled.scrollSteps() * 2);
+    sim.render(scrolled);
+    oled.stopscroll(true);
+    if (nowMs() != tick) continue;
+
+    oled.display();
+    sim.render(stopped);
+    checked++;
+    if ((memcmp(scrolled, stopped, sizeof(stopped)) != 0 ||
+         memcmp(sim.ram, oled.getBuffer(), sizeof(sim.ram)) != 0) && bad++ < 5) {
+      printf("scroll follow: round %u, pages %u..%u\n", i, first, last);
+    }
+  }
+  failures += bad;
+  printf("%-14s %u scrolls\n", "scroll follow", checked);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) outdir = argv[1];
+
+  display.init();
+  frame("splash");
+
+  display.clearDisplay();
+  display.drawPixel(10, 10, WHITE);
+  frame("pixel");
+
+  display.clearDisplay();
+  for (int16_t i = 0; i < display.width(); i += 4) {
+    display.drawLine(0, 0, i, display.height() - 1, WHITE);
+  }
+  for (int16_t i = 0; i < display.height(); i += 4) {
+    display.drawLine(0, 0, display.width() - 1, i, WHITE);
+  }
+  frame("lines");
+
+  display.clearDisplay();
+  for (int16_t i = 0; i < display.height() / 2; i += 2) {
+    display.drawRect(i, i, display.width() - 2 * i, display.height() - 2 * i, WHITE);
+  }
+  frame("rects");
+
+  display.clearDisplay();
+  for (int16_t i = 0; i < display.height(); i += 2) {
+    display.drawCircle(display.width() / 2, display.height() / 2, i, WHITE);
+  }
+  frame("circles");
+
+  display.clearDisplay();
+  display.fillRoundRect(10, 10, 50, 30, 8, WHITE);
+  display.fillTriangle(64, 4, 80, 60, 120, 30, WHITE);
+  display.fillCircle(30, 50, 10, INVERSE);
+  frame("fills");
+
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(WHITE);
+  display.setCursor(0, 0);
+  display.println("Hello, world!");
+  display.setTextColor(BLACK, WHITE);
+  display.println(3.141592);
+  display.setTextSize(2);
+  display.setTextColor(WHITE);
+  display.print("0x");
+  display.println(0xDEADBEEF, 16);
+  frame("text");
+
+  // a counter ticking over: only the digits should go out
+  display.setTextSize(1);
+  display.setTextColor(WHITE, BLACK);
+  display.setCursor(100, 56);
+  display.print(42);
+  frame("counter");
+
+  display.clearDisplay();
+  display.drawBitmap(30, 16, logo16_glcd_bmp, 16, 16, WHITE);
+  frame("bitmap");
+
+  display.setRotation(1);
+  display.clearDisplay();
+  display.setCursor(0, 0);
+  display.setTextSize(1);
+  display.println("rot 1");
+  display.drawRect(0, 10, display.width(), 20, WHITE);
+  frame("rotated");
+  display.setRotation(0);
+
+  checkNumbers();
+  checkPrimitives<128, 64, SSD1306_COMPINS_ALT>("primitives", 4000);
+  checkPrimitives<128, 32, SSD1306_COMPINS_SEQ>("128x32", 2000);
+  checkPrimitives<64, 48, SSD1306_COMPINS_ALT>("64x48", 2000);
+  checkDisplayList(3000);
+  checkRegions(2000);
+  checkDiffMode(2000);
+  checkConsole(300);
+  checkScrollFollow(100);
+
+  printf("%d frames, %d mismatches\n", frames, failures);
+  return failures ? 1 : 0;
+}